@@ -1,94 +1,6931 @@
+// Build: gcc -O3 -pthread -o locks "Combination Locks in C with x86_64 Intel Assembly.c" -lm
+// (or with -DLOCK_PYTHON_MODULE as a Python extension, see the end of the file)
+
+#define _GNU_SOURCE
+#ifdef LOCK_PYTHON_MODULE
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>     //Has to come before the system headers
+#endif
 #include <stdio.h>
-#include <math.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <complex.h>
+#include <immintrin.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <stddef.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/perf_event.h>
+#include <cpuid.h>
+
+// "00" "01" ... "99": both digits of x % 100 in one lookup
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static inline int wheel_cost(int S_new, int E_new) {
+    //Turn the short way around: at most 5 steps per wheel
+    int D = (E_new >= S_new) ? E_new - S_new : S_new - E_new;
+    return (D <= 5) ? D : 10 - D;
+}
+
+// Cost over the lowest N decimal digits of two 64-bit codes (up to 20 digits; anything
+// above the top digit is a zero on both sides). No floating point: x / 100 compiles to a
+// multiply by the reciprocal and each quotient step yields two digits via digit_pairs.
+int unlocker_u64(int N, uint64_t S, uint64_t E) {
+    int P = 0;
 
-int P;
-clock_t t;
-time_t t1;
+    for (; N >= 2 && (S | E) != 0; N -= 2) {
+        uint64_t qS = S / 100;
+        uint64_t qE = E / 100;
+        const char *dS = &digit_pairs[2 * (S - qS * 100)];
+        const char *dE = &digit_pairs[2 * (E - qE * 100)];
+
+        P += wheel_cost(dS[0], dE[0]) + wheel_cost(dS[1], dE[1]);
+        S = qS;
+        E = qE;
+    }
+    if (N == 1) {
+        P += wheel_cost(S % 10, E % 10);
+    }
+
+    return P;
+}
+
+// Same for 128-bit codes (up to 39 digits), taken 19 digits at a time through unlocker_u64()
+int unlocker_u128(int N, unsigned __int128 S, unsigned __int128 E) {
+    const uint64_t TEN19 = 10000000000000000000ULL;
+    int P = 0;
 
-int subtractor(int A, int B) {
-    int C;
+    for (; N > 0 && (S | E) != 0; N -= 19) {
+        P += unlocker_u64((N < 19) ? N : 19, (uint64_t)(S % TEN19), (uint64_t)(E % TEN19));
+        S /= TEN19;
+        E /= TEN19;
+    }
 
-    __asm__ (
-        "sub %2, %1\n\t"
-        "mov %1, %0"
-        : "=r" (C)
-        : "r" (A), "r" (B)
-    );
+    return P;
 }
 
+// Codes are non-negative and N is the number of wheels
 int unlocker(int N, int S, int E) {
+    return unlocker_u64(N, (uint64_t)S, (uint64_t)E);
+}
+
+// Table-driven kernels. pair_cost[a][b] is the cost of turning the two wheels holding a
+// (00-99) to b, 10 KB so it stays in L1; every lookup covers two wheels. The optional
+// whole-code table covers four wheels per lookup (10^4 x 10^4 bytes = 100 MB) and is only
+// used once lock_lut4_init() has managed to allocate it.
+static uint8_t pair_cost[100][100];
+static uint8_t *code_cost = NULL;
+
+void lock_lut_init(void) {
+    int a, b;
+
+    for (a = 0; a < 100; a++) {
+        for (b = 0; b < 100; b++) {
+            pair_cost[a][b] = wheel_cost(a / 10, b / 10) + wheel_cost(a % 10, b % 10);
+        }
+    }
+}
+
+// Returns 0 if there isn't memory for the table
+int lock_lut4_init(void) {
+    int a, b;
+
+    if (code_cost != NULL) {
+        return 1;
+    }
+    code_cost = malloc(10000 * 10000);
+    if (code_cost == NULL) {
+        return 0;
+    }
+    for (a = 0; a < 10000; a++) {
+        for (b = 0; b < 10000; b++) {
+            code_cost[a * 10000 + b] = pair_cost[a / 100][b / 100] + pair_cost[a % 100][b % 100];
+        }
+    }
+
+    return 1;
+}
+
+void lock_lut4_free(void) {
+    free(code_cost);
+    code_cost = NULL;
+}
+
+// unlocker_u64() with two wheels per lookup; lock_lut_init() must have run
+int unlocker_u64_lut(int N, uint64_t S, uint64_t E) {
+    int P = 0;
+
+    for (; N >= 2 && (S | E) != 0; N -= 2) {
+        P += pair_cost[S % 100][E % 100];
+        S /= 100;
+        E /= 100;
+    }
+    if (N == 1) {
+        P += wheel_cost(S % 10, E % 10);
+    }
+
+    return P;
+}
+
+// Four wheels per lookup when the whole-code table exists, pairs for what's left
+int unlocker_u64_lut4(int N, uint64_t S, uint64_t E) {
     int P = 0;
-    int S_new = 0;
-    int E_new = 0;
+
+    if (code_cost != NULL) {
+        for (; N >= 4 && (S | E) != 0; N -= 4) {
+            P += code_cost[(S % 10000) * 10000 + E % 10000];
+            S /= 10000;
+            E /= 10000;
+        }
+    }
+
+    return P + unlocker_u64_lut(N, S, E);
+}
+
+void unlocker_batch_lut(int N, const int *S, const int *E, int *P, size_t count) {
+    size_t k;
+
+    if (N == 4 && code_cost != NULL) {
+        for (k = 0; k < count; k++) {
+            P[k] = code_cost[S[k] % 10000 * 10000 + E[k] % 10000];
+        }
+        return;
+    }
+    for (k = 0; k < count; k++) {
+        P[k] = unlocker_u64_lut(N, (uint64_t)S[k], (uint64_t)E[k]);
+    }
+}
+
+//Pairs per block in the batch kernels
+#define BATCH_BLOCK 256
+
+// Fixed-width kernels, generated per (wheel count, radix, word type). With all three known
+// at compile time the loop unrolls completely, every S / R^i % R becomes a multiply by a
+// constant, the wheels are independent of each other and min(D, R-D) is branch-free.
+// T only needs to hold R^N, so most sizes get 32-bit math and the batch loop vectorizes.
+static inline uint64_t ipow(uint64_t R, int N) {
+    uint64_t p = 1;
+
+    while (N-- > 0) {
+        p *= R;
+    }
+    return p;
+}
+
+#define DEFINE_UNLOCKER_FIXED(N, R, T) \
+static inline int unlocker_fixed_##N##_##R##_raw(T S, T E) { \
+    T p = 1; \
+    int P = 0; \
+    int i; \
+    _Pragma("GCC unroll 32") \
+    for (i = 0; i < N; i++) { \
+        int D = (int)(S / p % R) - (int)(E / p % R); \
+        D = (D < 0) ? -D : D; \
+        P += (D < R - D) ? D : R - D; \
+        p *= R; \
+    } \
+    return P; \
+} \
+static inline int unlocker_fixed_##N##_##R(uint64_t S, uint64_t E) { \
+    return unlocker_fixed_##N##_##R##_raw((T)(S % ipow(R, N)), (T)(E % ipow(R, N))); \
+} \
+static void unlocker_batch_fixed_##N##_##R(const uint64_t *S, const uint64_t *E, int *P, size_t count) { \
+    size_t k, j, m; \
+    for (k = 0; k < count; k += m) { \
+        uint64_t top = 0; \
+        m = (count - k < BATCH_BLOCK) ? count - k : BATCH_BLOCK; \
+        for (j = k; j < k + m; j++) { \
+            top |= S[j] | E[j]; \
+        } \
+        /* Codes already below R^N (the usual case) skip the 64-bit reduction */ \
+        if (top < ipow(R, N)) { \
+            for (j = k; j < k + m; j++) { \
+                P[j] = unlocker_fixed_##N##_##R##_raw((T)S[j], (T)E[j]); \
+            } \
+        } \
+        else { \
+            for (j = k; j < k + m; j++) { \
+                P[j] = unlocker_fixed_##N##_##R(S[j], E[j]); \
+            } \
+        } \
+    } \
+}
+
+DEFINE_UNLOCKER_FIXED(3, 10, uint32_t)
+DEFINE_UNLOCKER_FIXED(4, 10, uint32_t)
+DEFINE_UNLOCKER_FIXED(6, 10, uint32_t)
+DEFINE_UNLOCKER_FIXED(8, 10, uint32_t)
+
+// unlocker_u64() routed to a fixed-width kernel when N has one
+int unlocker_fixed(int N, uint64_t S, uint64_t E) {
+    switch (N) {
+    case 3: return unlocker_fixed_3_10(S, E);
+    case 4: return unlocker_fixed_4_10(S, E);
+    case 6: return unlocker_fixed_6_10(S, E);
+    case 8: return unlocker_fixed_8_10(S, E);
+    default: return unlocker_u64(N, S, E);
+    }
+}
+
+// P[k] = unlocker_u64(N, S[k], E[k]), dispatched once per batch rather than per pair
+void unlocker_batch_u64(int N, const uint64_t *S, const uint64_t *E, int *P, size_t count) {
+    size_t k;
+
+    switch (N) {
+    case 3: unlocker_batch_fixed_3_10(S, E, P, count); return;
+    case 4: unlocker_batch_fixed_4_10(S, E, P, count); return;
+    case 6: unlocker_batch_fixed_6_10(S, E, P, count); return;
+    case 8: unlocker_batch_fixed_8_10(S, E, P, count); return;
+    }
+    for (k = 0; k < count; k++) {
+        P[k] = unlocker_u64(N, S[k], E[k]);
+    }
+}
+
+// Batch version of unlocker(): P[k] = unlocker(N, S[k], E[k]) for every k < count.
+// Starts, targets and costs are separate arrays (structure-of-arrays). Pairs are taken
+// in blocks and walked one digit position at a time, so the inner loop runs across
+// pairs and vectorizes (the /10 and %10 become multiplies).
+void unlocker_batch(int N, const int *S, const int *E, int *P, size_t count) {
+    unsigned int s[BATCH_BLOCK];
+    unsigned int e[BATCH_BLOCK];
+    int c[BATCH_BLOCK];
+    size_t k, j, m;
     int i;
 
-    for (i = (N-1); i >= 0; i--) {
+    //An int has at most 10 digits, the rest are zeros on both sides
+    if (N > 10) {
+        N = 10;
+    }
 
-        int S_new = floor(S / pow(10, i));
-        int E_new = floor(E / pow(10, i));
-        S_new = S_new % 10;
-        E_new = E_new % 10;
+    for (k = 0; k < count; k += m) {
+        m = (count - k < BATCH_BLOCK) ? count - k : BATCH_BLOCK;
 
-        if (E_new >= S_new) {
-            if ((subtractor(E_new, S_new) >= 0) && (subtractor(E_new, S_new) <= 5)) {
-                P += subtractor(E_new, S_new);
+        for (j = 0; j < m; j++) {
+            s[j] = S[k + j];
+            e[j] = E[k + j];
+            c[j] = 0;
+        }
+        for (i = 0; i < N; i++) {
+            for (j = 0; j < m; j++) {
+                int D = (int)(s[j] % 10) - (int)(e[j] % 10);
+                D = (D < 0) ? -D : D;
+                c[j] += (D <= 5) ? D : 10 - D;
+                s[j] /= 10;
+                e[j] /= 10;
             }
-            else {
-                P += subtractor(10, E_new) + S_new;
+        }
+        memcpy(P + k, c, m * sizeof(int));
+    }
+}
+
+// Same cost as unlocker(), but the codes are N-digit strings/byte buffers of any length.
+// Digits may be ASCII ('0'-'9') or raw values (0-9) as long as S and E use the same encoding,
+// since only their difference matters. Linear time, no allocation.
+long long unlocker_digits(size_t N, const char *S, const char *E) {
+    long long P = 0;
+    size_t i;
+
+    for (i = 0; i < N; i++) {
+        int D = (unsigned char)E[i] - (unsigned char)S[i];
+        if (D < 0) {
+            D = -D;
+        }
+        P += (D <= 5) ? D : 10 - D;
+    }
+
+    return P;
+}
+
+// SIMD versions of unlocker_digits(): per wheel |E-S| via saturating subtracts both ways,
+// min(D, 10-D) via unsigned min, then a horizontal sum with sad_epu8 into 64-bit lanes.
+// Leftover digits go through the scalar loop.
+__attribute__((target("sse2")))
+long long unlocker_digits_sse2(size_t N, const char *S, const char *E) {
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 16 <= N; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(S + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(E + i));
+        __m128i D = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+        __m128i C = _mm_min_epu8(D, _mm_sub_epi8(ten, D));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(C, zero));
+    }
+
+    long long P = _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+    return P + unlocker_digits(N - i, S + i, E + i);
+}
+
+__attribute__((target("avx2")))
+long long unlocker_digits_avx2(size_t N, const char *S, const char *E) {
+    const __m256i ten = _mm256_set1_epi8(10);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+
+    //64 wheels per iteration, two independent accumulators
+    for (; i + 64 <= N; i += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(S + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(E + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(S + i + 32));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(E + i + 32));
+        __m256i D0 = _mm256_or_si256(_mm256_subs_epu8(a0, b0), _mm256_subs_epu8(b0, a0));
+        __m256i D1 = _mm256_or_si256(_mm256_subs_epu8(a1, b1), _mm256_subs_epu8(b1, a1));
+        __m256i C0 = _mm256_min_epu8(D0, _mm256_sub_epi8(ten, D0));
+        __m256i C1 = _mm256_min_epu8(D1, _mm256_sub_epi8(ten, D1));
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(C0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(C1, zero));
+    }
+    for (; i + 32 <= N; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(S + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(E + i));
+        __m256i D = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+        __m256i C = _mm256_min_epu8(D, _mm256_sub_epi8(ten, D));
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(C, zero));
+    }
+
+    acc0 = _mm256_add_epi64(acc0, acc1);
+    __m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc0), _mm256_extracti128_si256(acc0, 1));
+    long long P = _mm_cvtsi128_si64(acc) + _mm_cvtsi128_si64(_mm_unpackhi_epi64(acc, acc));
+    return P + unlocker_digits_sse2(N - i, S + i, E + i);
+}
+
+__attribute__((target("avx512bw")))
+long long unlocker_digits_avx512(size_t N, const char *S, const char *E) {
+    const __m512i ten = _mm512_set1_epi8(10);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+
+    for (; i + 128 <= N; i += 128) {
+        __m512i a0 = _mm512_loadu_si512(S + i);
+        __m512i b0 = _mm512_loadu_si512(E + i);
+        __m512i a1 = _mm512_loadu_si512(S + i + 64);
+        __m512i b1 = _mm512_loadu_si512(E + i + 64);
+        __m512i D0 = _mm512_or_si512(_mm512_subs_epu8(a0, b0), _mm512_subs_epu8(b0, a0));
+        __m512i D1 = _mm512_or_si512(_mm512_subs_epu8(a1, b1), _mm512_subs_epu8(b1, a1));
+        __m512i C0 = _mm512_min_epu8(D0, _mm512_sub_epi8(ten, D0));
+        __m512i C1 = _mm512_min_epu8(D1, _mm512_sub_epi8(ten, D1));
+        acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(C0, zero));
+        acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(C1, zero));
+    }
+    //Masked loads cover the tail; the zeroed lanes cost nothing
+    for (; i < N; i += 64) {
+        __mmask64 m = (N - i >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (N - i)) - 1);
+        __m512i a = _mm512_maskz_loadu_epi8(m, S + i);
+        __m512i b = _mm512_maskz_loadu_epi8(m, E + i);
+        __m512i D = _mm512_or_si512(_mm512_subs_epu8(a, b), _mm512_subs_epu8(b, a));
+        __m512i C = _mm512_min_epu8(D, _mm512_sub_epi8(ten, D));
+        acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(C, zero));
+    }
+
+    return _mm512_reduce_add_epi64(_mm512_add_epi64(acc0, acc1));
+}
+
+// Kernel backends for the digit-string lock cost. lock_backend_select() picks the widest one
+// the CPU supports, unless a name is forced (argument, or the LOCK_BACKEND env var).
+// Every backend returns exactly what the scalar one does.
+struct lock_backend {
+    const char *name;
+    int (*supported)(void);
+    long long (*digits)(size_t N, const char *S, const char *E);
+};
+
+static int cpu_any(void) { return 1; }
+static int cpu_sse2(void) { return __builtin_cpu_supports("sse2"); }
+static int cpu_avx2(void) { return __builtin_cpu_supports("avx2"); }
+static int cpu_avx512(void) { return __builtin_cpu_supports("avx512bw"); }
+
+//Ordered narrowest to widest
+const struct lock_backend lock_backends[] = {
+    { "scalar", cpu_any, unlocker_digits },
+    { "sse2", cpu_sse2, unlocker_digits_sse2 },
+    { "avx2", cpu_avx2, unlocker_digits_avx2 },
+    { "avx512", cpu_avx512, unlocker_digits_avx512 },
+};
+#define LOCK_BACKENDS ((int)(sizeof(lock_backends) / sizeof(lock_backends[0])))
+
+const struct lock_backend *lock_backend = NULL;
+
+// Returns NULL if the named backend doesn't exist or the CPU can't run it
+const struct lock_backend *lock_backend_select(const char *name) {
+    int i;
+
+    if (name == NULL) {
+        name = getenv("LOCK_BACKEND");
+    }
+    if (name == NULL || *name == '\0' || strcmp(name, "auto") == 0) {
+        for (i = LOCK_BACKENDS - 1; i >= 0; i--) {
+            if (lock_backends[i].supported()) {
+                return lock_backend = &lock_backends[i];
             }
         }
-        else {
-            if ((subtractor(S_new, E_new) >= 0) && (subtractor(S_new, E_new) <= 5)) {
-                P += subtractor(S_new, E_new);
+    }
+    for (i = 0; i < LOCK_BACKENDS; i++) {
+        if (strcmp(name, lock_backends[i].name) == 0) {
+            return lock_backends[i].supported() ? (lock_backend = &lock_backends[i]) : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+// Digit-string lock cost on the selected backend
+long long lock_cost(size_t N, const char *S, const char *E) {
+    if (lock_backend == NULL) {
+        lock_backend_select(NULL);
+    }
+
+    return lock_backend->digits(N, S, E);
+}
+
+// Wheels with any radix. A wheel kind lists its symbols in turning order ("0123456789",
+// "0123456789ABCDEF", "ABCDEFGHIJKLMNOPQRSTUVWXYZ", ...); a lock descriptor says which kind
+// each wheel is. Costs are taken on symbol positions, min(D, R-D) per wheel.
+struct lock_wheel {
+    const char *symbols;
+    int radix;
+    int contiguous;         //symbols are consecutive bytes, so text can be used as positions
+    int8_t index[256];      //symbol -> position, -1 if it isn't on this wheel
+};
+
+struct lock_desc {
+    size_t wheels;
+    const struct lock_wheel *kinds;
+    const uint8_t *kind;    //kind of each wheel, NULL when every wheel is kinds[0]
+};
+
+void lock_wheel_init(struct lock_wheel *w, const char *symbols) {
+    int i;
+
+    w->symbols = symbols;
+    w->radix = (int)strlen(symbols);
+    w->contiguous = 1;
+    memset(w->index, -1, sizeof(w->index));
+    for (i = 0; i < w->radix; i++) {
+        w->index[(unsigned char)symbols[i]] = (int8_t)i;
+        if (symbols[i] != symbols[0] + i) {
+            w->contiguous = 0;
+        }
+    }
+}
+
+// Uniform-radix kernels over position arrays (or contiguous-alphabet text), generated per
+// radix so R - D folds to a constant; the loop is branch-free and vectorizes
+#define DEFINE_UNLOCKER_RADIX(R) \
+long long unlocker_radix_##R(size_t N, const uint8_t *S, const uint8_t *E) { \
+    long long P = 0; \
+    size_t i; \
+    for (i = 0; i < N; i++) { \
+        int D = (S[i] > E[i]) ? S[i] - E[i] : E[i] - S[i]; \
+        P += (D < R - D) ? D : R - D; \
+    } \
+    return P; \
+}
+
+DEFINE_UNLOCKER_RADIX(16)
+DEFINE_UNLOCKER_RADIX(26)
+
+// Any single radix, chosen at run time
+long long unlocker_radix(int R, size_t N, const uint8_t *S, const uint8_t *E) {
+    long long P = 0;
+    size_t i;
+
+    switch (R) {
+    case 10: return lock_cost(N, (const char *)S, (const char *)E);
+    case 16: return unlocker_radix_16(N, S, E);
+    case 26: return unlocker_radix_26(N, S, E);
+    }
+    for (i = 0; i < N; i++) {
+        int D = (S[i] > E[i]) ? S[i] - E[i] : E[i] - S[i];
+        P += (D < R - D) ? D : R - D;
+    }
+
+    return P;
+}
+
+// Mixed locks: wheel i has radix R[i]
+long long unlocker_mixed(size_t N, const uint8_t *R, const uint8_t *S, const uint8_t *E) {
+    long long P = 0;
+    size_t i;
+
+    for (i = 0; i < N; i++) {
+        int D = (S[i] > E[i]) ? S[i] - E[i] : E[i] - S[i];
+        P += (D < R[i] - D) ? D : R[i] - D;
+    }
+
+    return P;
+}
+
+// Cost between two codes written in the descriptor's symbols, or -1 if a symbol isn't on
+// its wheel. Uniform contiguous alphabets run straight on the text (base 10 through the
+// SIMD backend); anything else is translated to positions a block at a time on the stack.
+long long lock_desc_cost(const struct lock_desc *d, const char *S, const char *E) {
+    uint8_t s[4096], e[4096], r[4096];
+    long long P = 0;
+    size_t k, i, m;
+
+    if (d->kind == NULL && d->kinds[0].contiguous) {
+        const struct lock_wheel *w = &d->kinds[0];
+        const uint8_t lo = (uint8_t)w->symbols[0];
+        const uint8_t R = (uint8_t)w->radix;
+
+        //Validate a block while it is still in L1, then cost it
+        for (k = 0; k < d->wheels; k += m) {
+            uint8_t bad = 0;
+            m = (d->wheels - k < 16384) ? d->wheels - k : 16384;
+            for (i = k; i < k + m; i++) {
+                bad |= ((uint8_t)(S[i] - lo) >= R) | ((uint8_t)(E[i] - lo) >= R);
             }
-            else {
-                P += subtractor(10, S_new) + E_new;
-            }    
+            if (bad) {
+                return -1;
+            }
+            P += unlocker_radix(w->radix, m, (const uint8_t *)S + k, (const uint8_t *)E + k);
+        }
+        return P;
+    }
+
+    for (k = 0; k < d->wheels; k += m) {
+        m = (d->wheels - k < sizeof(s)) ? d->wheels - k : sizeof(s);
+
+        for (i = 0; i < m; i++) {
+            const struct lock_wheel *w = &d->kinds[(d->kind != NULL) ? d->kind[k + i] : 0];
+            int a = w->index[(unsigned char)S[k + i]];
+            int b = w->index[(unsigned char)E[k + i]];
+            if (a < 0 || b < 0) {
+                return -1;
+            }
+            s[i] = (uint8_t)a;
+            e[i] = (uint8_t)b;
+            r[i] = (uint8_t)w->radix;
         }
+        P += (d->kind == NULL) ? unlocker_radix(d->kinds[0].radix, m, s, e) : unlocker_mixed(m, r, s, e);
     }
 
     return P;
+}
+
+// Packed BCD codes: two digits per byte, first digit in the high nibble. An odd-length
+// code ends with a zero low nibble, which costs nothing against the other padded code.
+size_t lock_bcd_bytes(size_t N) {
+    return (N + 1) / 2;
+}
+
+// ASCII digits to packed BCD; dst needs lock_bcd_bytes(N) bytes
+void lock_bcd_pack(uint8_t *dst, const char *src, size_t N) {
+    size_t i;
+
+    for (i = 0; i + 1 < N; i += 2) {
+        dst[i / 2] = (uint8_t)(((src[i] - '0') << 4) | (src[i + 1] - '0'));
+    }
+    if (N & 1) {
+        dst[N / 2] = (uint8_t)((src[N - 1] - '0') << 4);
+    }
+}
+
+// Packed BCD back to ASCII digits (no terminator)
+void lock_bcd_unpack(char *dst, const uint8_t *src, size_t N) {
+    size_t i;
+
+    for (i = 0; i < N; i++) {
+        dst[i] = '0' + ((i & 1) ? (src[i / 2] & 0x0F) : (src[i / 2] >> 4));
+    }
+}
+
+// SWAR wheel cost for 8 byte lanes holding digits 0-9. Setting each lane's top bit before
+// subtracting keeps borrows inside the lane; the top bit of the result then says which
+// way round the subtraction went, and a second biased add tests D >= 6 for the wrap.
+static inline uint64_t swar_wheel_cost(uint64_t x, uint64_t y) {
+    const uint64_t H = 0x8080808080808080ULL;
+    const uint64_t LO7 = 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t d1 = (x | H) - y;
+    uint64_t d2 = (y | H) - x;
+    uint64_t m = ((d1 & H) >> 7) * 0xFF;
+    uint64_t D = ((d1 & m) | (d2 & ~m)) & LO7;
+    uint64_t W = ((0x0A0A0A0A0A0A0A0AULL | H) - D) & LO7;
+    uint64_t g = (((D + 0x7A7A7A7A7A7A7A7AULL) & H) >> 7) * 0xFF;
+
+    return (W & g) | (D & ~g);
+}
+
+// unlocker_digits() over packed BCD, 16 wheels per 64-bit word with plain integer ops
+long long unlocker_bcd(size_t N, const uint8_t *S, const uint8_t *E) {
+    const uint64_t NIB = 0x0F0F0F0F0F0F0F0FULL;
+    size_t bytes = lock_bcd_bytes(N);
+    long long P = 0;
+    size_t i;
+
+    for (i = 0; i < bytes; i += 8) {
+        uint64_t x = 0, y = 0;
+        size_t n = (bytes - i < 8) ? bytes - i : 8;
+
+        memcpy(&x, S + i, n);
+        memcpy(&y, E + i, n);
 
+        //High and low nibbles in separate byte lanes, lane sums stay <= 10
+        uint64_t c = swar_wheel_cost((x >> 4) & NIB, (y >> 4) & NIB) + swar_wheel_cost(x & NIB, y & NIB);
+        P += (c * 0x0101010101010101ULL) >> 56;
+    }
+
+    return P;
 }
 
-int main(void) {
-    srand((unsigned) time(&t1));
+// Lock session: a lock whose target stays put while wheels change, with the cost to the
+// target always at hand. Wheels are grouped in blocks of LOCK_SESSION_BLOCK; a segment
+// tree over the blocks keeps, per node, how many wheels sit at each residue
+// (current - target) mod 10, and the cost of a node is sum cnt[r] * min(r, 10 - r). A
+// range of wheels can be rotated or set to one digit with a lazy tag per node: rotating
+// shifts the residue counts, and setting rebuilds them from the node's target digit
+// counts. So a single wheel costs O(log N) (ancestors just move one count), a range
+// O(log N + block), and the total is read in O(1).
+#define LOCK_SESSION_BLOCK 64
+
+// Tags: 0 nothing, 1-9 rotate by that many steps, 10 + d set to digit d
+struct lock_session_node {
+    uint32_t cnt[10];       //wheels per residue, this node's tag already applied
+    uint32_t tcnt[10];      //wheels per target digit
+    uint8_t tag;            //still to be applied to the children
+};
 
-    // int N = 4;
-    // int S = 1234;
-    // int E = 9899;
+struct lock_session {
+    size_t n;
+    size_t size;            //leaf count, a power of two; leaf b is node size + b
+    uint8_t *cur;           //digits 0-9, missing the tags of the leaf and its ancestors
+    uint8_t *target;
+    struct lock_session_node *node;
+    uint64_t *dirty;        //nodes with stale counts during lock_session_apply()
+    long long total;
+};
 
-    // int N = 0;
-    // int S = 0;
-    // int E = 0;
+enum { LOCK_MOVE_SET, LOCK_MOVE_TURN, LOCK_MOVE_ROTATE, LOCK_MOVE_ASSIGN };
 
-    int j = 0;
+// One entry of a move log. SET and TURN change wheel first (value = digit or steps,
+// negative steps turn the other way); ROTATE and ASSIGN do the same to wheels [first, last).
+struct lock_move {
+    uint32_t kind;
+    int32_t value;
+    uint64_t first;
+    uint64_t last;
+};
 
-    t = clock();
-    for (j = 0; j < 100000; j++) {
-        //For same lengths (Comment for different lengths and uncomment this section)
-        int N = 4;
-        int S = rand()%9000 + 1000;
-        int E = rand()%9000 + 1000;
+static inline int lock_tag_digit(int tag, int d) {
+    return (tag >= 10) ? tag - 10 : (d + tag) % 10;
+}
+
+// Tag b applied after tag a
+static inline uint8_t lock_tag_compose(uint8_t a, uint8_t b) {
+    if (b >= 10 || b == 0) {
+        return (b >= 10) ? b : a;
+    }
+    return (a >= 10) ? (uint8_t)(10 + (a - 10 + b) % 10) : (uint8_t)((a + b) % 10);
+}
 
-        //For different lengths (Comment for same lengths and uncomment this section)
-        // int N = rand()%100 + 1;
-        // int pow1 = pow(10, N) - pow(10, N-1);
-        // int S = rand()%pow1 + pow(10, N-1);
-        // int E = rand()%pow1 + pow(10, N-1);
+static long long lock_node_cost(const struct lock_session_node *x) {
+    return x->cnt[1] + x->cnt[9] + 2LL * (x->cnt[2] + x->cnt[8]) + 3LL * (x->cnt[3] + x->cnt[7]) +
+           4LL * (x->cnt[4] + x->cnt[6]) + 5LL * x->cnt[5];
+}
+
+// Applies tag to x's counts and queues it for x's children
+static void lock_node_apply(struct lock_session_node *x, uint8_t tag) {
+    uint32_t c[10];
+    int r;
 
-        P = unlocker(N, S, E);
+    if (tag == 0) {
+        return;
+    }
+    if (tag >= 10) {
+        //A wheel with target t ends up at residue (d - t) mod 10
+        for (r = 0; r < 10; r++) {
+            c[(tag - 10 - r + 10) % 10] = x->tcnt[r];
+        }
     }
-    t = clock() - t;
-    double time_taken = ((double)(t)) / CLOCKS_PER_SEC;
+    else {
+        for (r = 0; r < 10; r++) {
+            c[(r + tag) % 10] = x->cnt[r];
+        }
+    }
+    memcpy(x->cnt, c, sizeof(c));
+    x->tag = lock_tag_compose(x->tag, tag);
+}
 
-    printf("%d\n", P);
-    printf("%f\n", time_taken);
-    // printf("%d\n", N);
-    // printf("%d\n", S);
-    // printf("%d\n", E);
+// Recounts an inner node from its children, then applies its own pending tag
+static void lock_node_pull(struct lock_session *s, size_t i) {
+    struct lock_session_node *x = &s->node[i];
+    uint8_t tag = x->tag;
+    int r;
 
-    return 0;
-}
\ No newline at end of file
+    for (r = 0; r < 10; r++) {
+        x->cnt[r] = s->node[2 * i].cnt[r] + s->node[2 * i + 1].cnt[r];
+    }
+    x->tag = 0;
+    lock_node_apply(x, tag);
+}
+
+static void lock_node_push(struct lock_session *s, size_t i) {
+    if (s->node[i].tag != 0) {
+        lock_node_apply(&s->node[2 * i], s->node[i].tag);
+        lock_node_apply(&s->node[2 * i + 1], s->node[i].tag);
+        s->node[i].tag = 0;
+    }
+}
+
+// Folds a leaf's tag into its digits
+static void lock_leaf_settle(struct lock_session *s, size_t b) {
+    struct lock_session_node *x = &s->node[s->size + b];
+    size_t i, end = (b + 1) * LOCK_SESSION_BLOCK;
+
+    if (x->tag != 0) {
+        for (i = b * LOCK_SESSION_BLOCK; i < end && i < s->n; i++) {
+            s->cur[i] = (uint8_t)lock_tag_digit(x->tag, s->cur[i]);
+        }
+        x->tag = 0;
+    }
+}
+
+static void lock_leaf_count(struct lock_session *s, size_t b) {
+    struct lock_session_node *x = &s->node[s->size + b];
+    size_t i, end = (b + 1) * LOCK_SESSION_BLOCK;
+
+    memset(x->cnt, 0, sizeof(x->cnt));
+    for (i = b * LOCK_SESSION_BLOCK; i < end && i < s->n; i++) {
+        x->cnt[(s->cur[i] - s->target[i] + 10) % 10]++;
+    }
+}
+
+// S and E are N-digit ASCII codes. Returns 0 on bad digits or allocation failure.
+int lock_session_init(struct lock_session *s, size_t N, const char *S, const char *E) {
+    size_t blocks = (N + LOCK_SESSION_BLOCK - 1) / LOCK_SESSION_BLOCK, i, b;
+
+    memset(s, 0, sizeof(*s));
+    for (i = 0; i < N; i++) {
+        if ((unsigned char)(S[i] - '0') > 9 || (unsigned char)(E[i] - '0') > 9) {
+            return 0;
+        }
+    }
+    s->n = N;
+    for (s->size = 1; s->size < blocks; s->size *= 2) {
+    }
+    s->cur = malloc(N + 1);
+    s->target = malloc(N + 1);
+    s->node = calloc(2 * s->size, sizeof(struct lock_session_node));
+    s->dirty = calloc((2 * s->size + 63) / 64, sizeof(uint64_t));
+    if (s->cur == NULL || s->target == NULL || s->node == NULL || s->dirty == NULL) {
+        free(s->cur);
+        free(s->target);
+        free(s->node);
+        free(s->dirty);
+        return 0;
+    }
+
+    for (i = 0; i < N; i++) {
+        s->cur[i] = (uint8_t)(S[i] - '0');
+        s->target[i] = (uint8_t)(E[i] - '0');
+    }
+    for (b = 0; b < blocks; b++) {
+        struct lock_session_node *x = &s->node[s->size + b];
+
+        lock_leaf_count(s, b);
+        for (i = b * LOCK_SESSION_BLOCK; i < (b + 1) * LOCK_SESSION_BLOCK && i < N; i++) {
+            x->tcnt[s->target[i]]++;
+        }
+    }
+    for (i = s->size - 1; i >= 1; i--) {
+        for (b = 0; b < 10; b++) {
+            s->node[i].tcnt[b] = s->node[2 * i].tcnt[b] + s->node[2 * i + 1].tcnt[b];
+        }
+        lock_node_pull(s, i);
+    }
+    s->total = lock_node_cost(&s->node[1]);
+
+    return 1;
+}
+
+void lock_session_free(struct lock_session *s) {
+    free(s->cur);
+    free(s->target);
+    free(s->node);
+    free(s->dirty);
+    memset(s, 0, sizeof(*s));
+}
+
+static inline long long lock_session_cost(const struct lock_session *s) {
+    return s->total;
+}
+
+// Current digit of wheel i: its stored digit under every tag from its leaf up to the root
+int lock_session_digit(const struct lock_session *s, size_t i) {
+    size_t x = s->size + i / LOCK_SESSION_BLOCK;
+    int d = s->cur[i];
+
+    for (; x >= 1; x /= 2) {
+        d = lock_tag_digit(s->node[x].tag, d);
+    }
+    return d;
+}
+
+// All current digits as ASCII (no terminator)
+void lock_session_digits(const struct lock_session *s, char *out) {
+    size_t i;
+
+    for (i = 0; i < s->n; i++) {
+        out[i] = (char)('0' + lock_session_digit(s, i));
+    }
+}
+
+// Sets wheel i to digit d. With defer set the ancestors are only marked stale.
+static void lock_session_point(struct lock_session *s, size_t i, int d, int defer) {
+    size_t b = i / LOCK_SESSION_BLOCK, x, depth;
+    int from, to;
+
+    //Push the path's tags down to the leaf, top first
+    for (depth = 0; (s->size >> depth) > 1; depth++) {
+    }
+    for (; depth > 0; depth--) {
+        lock_node_push(s, (s->size + b) >> depth);
+    }
+    lock_leaf_settle(s, b);
+
+    from = (s->cur[i] - s->target[i] + 10) % 10;
+    to = (d - s->target[i] + 10) % 10;
+    s->cur[i] = (uint8_t)d;
+    if (from == to) {
+        return;
+    }
+    x = s->size + b;
+    s->node[x].cnt[from]--;
+    s->node[x].cnt[to]++;
+    if (defer) {
+        s->dirty[x / 64] |= 1ull << (x % 64);
+        return;
+    }
+    //Every ancestor is tag-free now, so each just moves one wheel between residues
+    for (x /= 2; x >= 1; x /= 2) {
+        s->node[x].cnt[from]--;
+        s->node[x].cnt[to]++;
+    }
+    s->total += wheel_cost(to, 0) - wheel_cost(from, 0);
+}
+
+// Applies tag to wheels [first, last) under node x, which covers blocks [lo, hi)
+static void lock_session_range(struct lock_session *s, size_t x, size_t lo, size_t hi, size_t first, size_t last, uint8_t tag) {
+    size_t wlo = lo * LOCK_SESSION_BLOCK, whi = hi * LOCK_SESSION_BLOCK;
+
+    if (last <= wlo || first >= whi) {
+        return;
+    }
+    if (first <= wlo && last >= whi) {
+        lock_node_apply(&s->node[x], tag);
+        return;
+    }
+    if (hi - lo == 1) {
+        size_t i;
+
+        lock_leaf_settle(s, lo);
+        for (i = (first > wlo ? first : wlo); i < last && i < whi; i++) {
+            s->cur[i] = (uint8_t)lock_tag_digit(tag, s->cur[i]);
+        }
+        lock_leaf_count(s, lo);
+        return;
+    }
+    lock_node_push(s, x);
+    lock_session_range(s, 2 * x, lo, (lo + hi) / 2, first, last, tag);
+    lock_session_range(s, 2 * x + 1, (lo + hi) / 2, hi, first, last, tag);
+    lock_node_pull(s, x);
+}
+
+static void lock_session_tag(struct lock_session *s, size_t first, size_t last, uint8_t tag) {
+    last = (last < s->n) ? last : s->n;
+    if (first < last && tag != 0) {
+        lock_session_range(s, 1, 0, s->size, first, last, tag);
+        s->total = lock_node_cost(&s->node[1]);
+    }
+}
+
+void lock_session_set(struct lock_session *s, size_t i, int d) {
+    if (i < s->n && d >= 0 && d <= 9) {
+        lock_session_point(s, i, d, 0);
+    }
+}
+
+void lock_session_turn(struct lock_session *s, size_t i, int steps) {
+    if (i < s->n) {
+        lock_session_point(s, i, ((lock_session_digit(s, i) + steps) % 10 + 10) % 10, 0);
+    }
+}
+
+// Turns every wheel in [first, last) by steps (negative turns the other way)
+void lock_session_rotate(struct lock_session *s, size_t first, size_t last, int steps) {
+    lock_session_tag(s, first, last, (uint8_t)((steps % 10 + 10) % 10));
+}
+
+// Sets every wheel in [first, last) to digit d
+void lock_session_assign(struct lock_session *s, size_t first, size_t last, int d) {
+    if (d >= 0 && d <= 9) {
+        lock_session_tag(s, first, last, (uint8_t)(10 + d));
+    }
+}
+
+// Recounts every node marked stale, a level at a time from the leaves up
+static void lock_session_sweep(struct lock_session *s) {
+    size_t lo;
+
+    for (lo = s->size; lo >= 1; lo /= 2) {
+        size_t i = lo;
+
+        while (i < 2 * lo) {
+            uint64_t w = s->dirty[i / 64] >> (i % 64);
+
+            if (w == 0) {
+                i = (i / 64 + 1) * 64;
+                continue;
+            }
+            i += (size_t)__builtin_ctzll(w);
+            if (i >= 2 * lo) {
+                break;
+            }
+            s->dirty[i / 64] &= ~(1ull << (i % 64));
+            if (i < s->size) {
+                lock_node_pull(s, i);
+            }
+            if (i > 1) {
+                s->dirty[i / 128] |= 1ull << (i / 2 % 64);
+            }
+            i++;
+        }
+    }
+    s->total = lock_node_cost(&s->node[1]);
+}
+
+// Applies a move log in order. With costs set, costs[k] is the cost after move k;
+// without, single-wheel moves leave their ancestors stale and one sweep at the end
+// recounts them. That's safe across range moves too: leaf counts are always right, and
+// a pull recounts a node from scratch. Returns the final cost.
+long long lock_session_apply(struct lock_session *s, const struct lock_move *m, size_t count, long long *costs) {
+    int defer = (costs == NULL), stale = 0;
+    size_t k;
+
+    for (k = 0; k < count; k++) {
+        switch (m[k].kind) {
+        case LOCK_MOVE_SET:
+        case LOCK_MOVE_TURN:
+            if (m[k].first < s->n) {
+                int d = (m[k].kind == LOCK_MOVE_SET) ? m[k].value : ((lock_session_digit(s, m[k].first) + m[k].value) % 10 + 10) % 10;
+                if (d >= 0 && d <= 9) {
+                    lock_session_point(s, m[k].first, d, defer);
+                    stale |= defer;
+                }
+            }
+            break;
+        case LOCK_MOVE_ROTATE:
+        case LOCK_MOVE_ASSIGN:
+            if (m[k].kind == LOCK_MOVE_ROTATE) {
+                lock_session_rotate(s, m[k].first, m[k].last, m[k].value);
+            }
+            else {
+                lock_session_assign(s, m[k].first, m[k].last, m[k].value);
+            }
+            break;
+        }
+        if (costs != NULL) {
+            costs[k] = s->total;
+        }
+    }
+    if (stale) {
+        lock_session_sweep(s);
+    }
+
+    return s->total;
+}
+
+// Workload generator. xoshiro256** run as four interleaved streams (state word x lane), so
+// lock_rng_fill() produces four outputs per step with lane loops that vectorize; the
+// multiplies by 5 and 9 are written as shift-adds for the same reason. Everything is
+// derived from an explicit seed, so a (seed, distribution, count, width) tuple always
+// gives the same codes.
+struct lock_rng {
+    uint64_t s[4][4];
+};
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void lock_rng_seed(struct lock_rng *r, uint64_t seed) {
+    int i, l;
+
+    for (l = 0; l < 4; l++) {
+        for (i = 0; i < 4; i++) {
+            r->s[i][l] = splitmix64(&seed);
+        }
+    }
+}
+
+// Fills out[0..n) (n a multiple of 4) with random words
+void lock_rng_fill(struct lock_rng *r, uint64_t *out, size_t n) {
+    size_t k;
+    int l;
+
+    for (k = 0; k + 4 <= n; k += 4) {
+        for (l = 0; l < 4; l++) {
+            uint64_t x = (r->s[1][l] << 2) + r->s[1][l];
+            x = (x << 7) | (x >> 57);
+            out[k + l] = (x << 3) + x;
+
+            uint64_t t = r->s[1][l] << 17;
+            r->s[2][l] ^= r->s[0][l];
+            r->s[3][l] ^= r->s[1][l];
+            r->s[1][l] ^= r->s[2][l];
+            r->s[0][l] ^= r->s[3][l];
+            r->s[2][l] ^= t;
+            r->s[3][l] = (r->s[3][l] << 45) | (r->s[3][l] >> 19);
+        }
+    }
+}
+
+// Small uniform draws (n <= 10) peeled off the top of buffered random words, 16 per word
+struct lock_draws {
+    struct lock_rng rng;
+    uint64_t buf[64];
+    int next;
+    uint64_t w;
+    int left;
+};
+
+static inline int lock_draw(struct lock_draws *d, int n) {
+    if (d->left == 0) {
+        if (d->next == 64) {
+            lock_rng_fill(&d->rng, d->buf, 64);
+            d->next = 0;
+        }
+        d->w = d->buf[d->next++];
+        d->left = 16;
+    }
+    d->left--;
+
+    unsigned __int128 m = (unsigned __int128)d->w * (unsigned)n;
+    d->w = (uint64_t)m;
+    return (int)(m >> 64);
+}
+
+// Uniform in [0, n) for large n, from a fresh word
+static inline uint64_t lock_draw_wide(struct lock_draws *d, uint64_t n) {
+    if (d->next == 64) {
+        lock_rng_fill(&d->rng, d->buf, 64);
+        d->next = 0;
+    }
+    return (uint64_t)(((unsigned __int128)d->buf[d->next++] * n) >> 64);
+}
+
+// Runs every supported backend against the scalar one on random codes of many lengths
+// and alignments, drawn from seed so a failure can be replayed. Returns the number of
+// mismatches.
+#define LOCK_CHECK_SEED 20240101
+
+int lock_backend_check(uint64_t seed) {
+    struct lock_draws d;
+    char S[1100], E[1100];
+    int bad = 0;
+    size_t n, off;
+    int i, k;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (k = 0; k < 200; k++) {
+        for (i = 0; i < (int)sizeof(S); i++) {
+            S[i] = '0' + lock_draw(&d, 10);
+            E[i] = '0' + lock_draw(&d, 10);
+        }
+        n = lock_draw_wide(&d, 1024);
+        off = lock_draw_wide(&d, 64);
+        long long want = unlocker_digits(n, S + off, E + off);
+
+        for (i = 1; i < LOCK_BACKENDS; i++) {
+            if (lock_backends[i].supported() && lock_backends[i].digits(n, S + off, E + off) != want) {
+                fprintf(stderr, "%s: mismatch at N = %zu (seed %llu, round %d)\n", lock_backends[i].name, n, (unsigned long long)seed, k);
+                bad++;
+            }
+        }
+    }
+
+    return bad;
+}
+
+// Replays random move logs on sessions of many lengths against unlocker_digits() on a
+// plain copy of the lock: a third move by move through the single-move calls, a third
+// through lock_session_apply() with per-move costs, a third through one deferred apply.
+// Returns the number of mismatches.
+#define LOCK_CHECK_MOVES 200
+
+int lock_session_check(uint64_t seed) {
+    static char S[4500], E[4500], cur[4500], out[4500];
+    struct lock_move m[LOCK_CHECK_MOVES];
+    long long want[LOCK_CHECK_MOVES], got[LOCK_CHECK_MOVES];
+    struct lock_session s;
+    struct lock_draws d;
+    size_t n, i, k;
+    int bad = 0, trial, how;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (trial = 0; trial < 150; trial++) {
+        //Short locks first, where most moves straddle a block edge
+        n = 1 + lock_draw_wide(&d, (trial < 50) ? 200 : sizeof(S));
+        for (i = 0; i < n; i++) {
+            S[i] = '0' + lock_draw(&d, 10);
+            E[i] = '0' + lock_draw(&d, 10);
+        }
+        if (!lock_session_init(&s, n, S, E)) {
+            return bad + 1;
+        }
+        memcpy(cur, S, n);
+        how = trial % 3;
+
+        for (k = 0; k < LOCK_CHECK_MOVES; k++) {
+            size_t first = lock_draw_wide(&d, n), last = lock_draw_wide(&d, n + 1);
+            int digit;
+
+            if (first > last) {
+                i = first;
+                first = last;
+                last = i;
+            }
+            m[k].kind = (uint32_t)lock_draw(&d, 4);
+            digit = (m[k].kind == LOCK_MOVE_SET || m[k].kind == LOCK_MOVE_ASSIGN);
+            m[k].value = digit ? lock_draw(&d, 10) : (int32_t)lock_draw_wide(&d, 31) - 15;
+            m[k].first = first;
+            m[k].last = last;
+            for (i = first; i < ((m[k].kind <= LOCK_MOVE_TURN) ? first + 1 : last); i++) {
+                cur[i] = (char)('0' + (digit ? m[k].value : ((cur[i] - '0' + m[k].value) % 10 + 10) % 10));
+            }
+            want[k] = unlocker_digits(n, cur, E);
+
+            if (how == 0) {
+                switch (m[k].kind) {
+                case LOCK_MOVE_SET: lock_session_set(&s, first, m[k].value); break;
+                case LOCK_MOVE_TURN: lock_session_turn(&s, first, m[k].value); break;
+                case LOCK_MOVE_ROTATE: lock_session_rotate(&s, first, last, m[k].value); break;
+                default: lock_session_assign(&s, first, last, m[k].value); break;
+                }
+                bad += (lock_session_cost(&s) != want[k]);
+            }
+        }
+        if (how != 0) {
+            bad += (lock_session_apply(&s, m, LOCK_CHECK_MOVES, (how == 1) ? got : NULL) != want[LOCK_CHECK_MOVES - 1]);
+            for (k = 0; how == 1 && k < LOCK_CHECK_MOVES; k++) {
+                bad += (got[k] != want[k]);
+            }
+        }
+        lock_session_digits(&s, out);
+        bad += (memcmp(out, cur, n) != 0);
+        lock_session_free(&s);
+    }
+
+    return bad;
+}
+
+enum lock_dist {
+    LOCK_DIST_UNIFORM,      //every digit uniform, leading zeros allowed
+    LOCK_DIST_FIXED,        //exactly width digits (leading digit nonzero), as the old main() did
+    LOCK_DIST_MIXED,        //length uniform in 1..width per code, right-aligned with '0' padding
+    LOCK_DIST_WRAP,         //every wheel turns more than 5 the direct way, so it always wraps
+    LOCK_DIST_HALF,         //every wheel is exactly half a turn (5) from its target
+    LOCK_DISTS
+};
+
+static const char *lock_dist_names[LOCK_DISTS] = { "uniform", "fixed", "mixed", "wrap", "half" };
+
+int lock_dist_parse(const char *name) {
+    int i;
+
+    for (i = 0; i < LOCK_DISTS; i++) {
+        if (strcmp(name, lock_dist_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// count pairs of width-digit ASCII codes, pair k at S/E + k * width
+struct lock_workload {
+    uint64_t seed;
+    int dist;
+    size_t count;
+    size_t width;
+    char *S;
+    char *E;
+};
+
+static void lock_workload_code(struct lock_draws *d, int dist, char *S, char *E, size_t width) {
+    size_t start = 0, i;
+
+    if (dist == LOCK_DIST_MIXED) {
+        start = width - 1 - (size_t)lock_draw_wide(d, width);
+        memset(S, '0', start);
+        memset(E, '0', start);
+    }
+
+    for (i = start; i < width; i++) {
+        int s, e;
+
+        switch (dist) {
+        case LOCK_DIST_WRAP:
+            //Only 0-3 and 6-9 have a target more than 5 away
+            s = lock_draw(d, 8);
+            s += (s >= 4) ? 2 : 0;
+            e = (s <= 3) ? s + 6 + lock_draw(d, 4 - s) : lock_draw(d, s - 5);
+            break;
+        case LOCK_DIST_HALF:
+            s = lock_draw(d, 10);
+            e = (s + 5) % 10;
+            break;
+        default:
+            if (i == start && dist != LOCK_DIST_UNIFORM) {
+                s = 1 + lock_draw(d, 9);
+                e = 1 + lock_draw(d, 9);
+            }
+            else {
+                s = lock_draw(d, 10);
+                e = lock_draw(d, 10);
+            }
+        }
+        S[i] = '0' + s;
+        E[i] = '0' + e;
+    }
+}
+
+void lock_workload_free(struct lock_workload *w) {
+    free(w->S);
+    free(w->E);
+    w->S = w->E = NULL;
+}
+
+// Returns 0 on allocation failure
+int lock_workload_generate(struct lock_workload *w, uint64_t seed, int dist, size_t count, size_t width) {
+    struct lock_draws d;
+    size_t k;
+
+    w->seed = seed;
+    w->dist = dist;
+    w->count = count;
+    w->width = width;
+    w->S = w->E = NULL;
+    if (width > 0 && count > (SIZE_MAX - 1) / width) {
+        return 0;
+    }
+    w->S = malloc(count * width + 1);
+    w->E = malloc(count * width + 1);
+    if (w->S == NULL || w->E == NULL) {
+        lock_workload_free(w);
+        return 0;
+    }
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (k = 0; k < count; k++) {
+        lock_workload_code(&d, dist, w->S + k * width, w->E + k * width, width);
+    }
+    w->S[count * width] = '\0';
+    w->E[count * width] = '\0';
+
+    return 1;
+}
+
+// Integer copies of the codes (width <= 19)
+void lock_workload_u64(const struct lock_workload *w, uint64_t *S, uint64_t *E) {
+    size_t k, i;
+
+    for (k = 0; k < w->count; k++) {
+        uint64_t s = 0, e = 0;
+        for (i = 0; i < w->width; i++) {
+            s = s * 10 + (w->S[k * w->width + i] - '0');
+            e = e * 10 + (w->E[k * w->width + i] - '0');
+        }
+        S[k] = s;
+        E[k] = e;
+    }
+}
+
+// On-disk cache: a header naming the generator parameters, then the S and E digits
+struct lock_workload_header {
+    char magic[8];
+    uint64_t seed;
+    uint64_t dist;
+    uint64_t count;
+    uint64_t width;
+};
+
+int lock_workload_save(const struct lock_workload *w, const char *path) {
+    struct lock_workload_header h = { "LOCKWL1", w->seed, (uint64_t)w->dist, w->count, w->width };
+    FILE *f = fopen(path, "wb");
+    int ok;
+
+    if (f == NULL) {
+        return 0;
+    }
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+         fwrite(w->S, 1, w->count * w->width, f) == w->count * w->width &&
+         fwrite(w->E, 1, w->count * w->width, f) == w->count * w->width;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        remove(path);
+    }
+
+    return ok;
+}
+
+// Loads the cached workload for these parameters, or generates it and writes the cache.
+// dir may be NULL (no caching). Returns 0 on allocation failure.
+int lock_workload_cached(struct lock_workload *w, const char *dir, uint64_t seed, int dist, size_t count, size_t width) {
+    struct lock_workload_header h;
+    char path[4096];
+    FILE *f;
+
+    if (dir == NULL || (width > 0 && count > (SIZE_MAX - 1) / width)) {
+        //An oversized request fails in lock_workload_generate() before touching the cache
+        return lock_workload_generate(w, seed, dist, count, width);
+    }
+
+    snprintf(path, sizeof(path), "%s/lock-%s-%llu-%zux%zu.bin", dir, lock_dist_names[dist],
+             (unsigned long long)seed, count, width);
+    f = fopen(path, "rb");
+    if (f != NULL) {
+        if (fread(&h, sizeof(h), 1, f) == 1 && memcmp(h.magic, "LOCKWL1", 8) == 0 && h.seed == seed &&
+            h.dist == (uint64_t)dist && h.count == count && h.width == width) {
+            w->seed = seed;
+            w->dist = dist;
+            w->count = count;
+            w->width = width;
+            w->S = malloc(count * width + 1);
+            w->E = malloc(count * width + 1);
+            if (w->S != NULL && w->E != NULL &&
+                fread(w->S, 1, count * width, f) == count * width &&
+                fread(w->E, 1, count * width, f) == count * width) {
+                w->S[count * width] = '\0';
+                w->E[count * width] = '\0';
+                fclose(f);
+                return 1;
+            }
+            lock_workload_free(w);
+        }
+        fclose(f);
+    }
+
+    if (!lock_workload_generate(w, seed, dist, count, width)) {
+        return 0;
+    }
+    lock_workload_save(w, path);
+
+    return 1;
+}
+
+// Wall-clock seconds (clock() adds up the CPU time of every thread)
+double now_seconds(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Thread-pool executor for bulk jobs. A run over [0, count) is cut into chunks and every
+// worker owns a contiguous run of them, packed as (first << 32 | last) in one atomic word.
+// The owner pops chunks from the front; once its own run is empty it steals from the back
+// of the other workers' runs. The calling thread works as worker 0.
+#define LOCK_MAX_THREADS 256
+
+typedef void (*lock_job_fn)(void *ctx, size_t begin, size_t end);
+
+struct lock_pool_config {
+    int threads;    //0 = every online core
+    size_t chunk;   //items per chunk, 0 = 16384
+    int pin;        //pin worker i to core i
+};
+
+struct lock_pool_stats {
+    int threads;
+    double seconds;
+    size_t items[LOCK_MAX_THREADS];
+    size_t chunks[LOCK_MAX_THREADS];
+    size_t stolen[LOCK_MAX_THREADS];
+    double busy[LOCK_MAX_THREADS];
+};
+
+struct lock_pool_queue {
+    _Atomic uint64_t range;
+    char pad[64 - sizeof(uint64_t)];
+};
+
+struct lock_pool {
+    int threads;
+    size_t chunk;
+    pthread_t tid[LOCK_MAX_THREADS];
+    struct lock_pool_queue queue[LOCK_MAX_THREADS];
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int running;
+    int quit;
+
+    //Current job
+    lock_job_fn fn;
+    void *ctx;
+    size_t count;
+    size_t run_chunk;       //chunk size for this job, chunk widened if it needs more than 2^32 chunks
+    struct lock_pool_stats *stats;
+};
+
+struct lock_pool_worker {
+    struct lock_pool *pool;
+    int id;
+};
+
+static struct lock_pool_worker lock_pool_workers[LOCK_MAX_THREADS];
+
+// Takes one chunk index from queue q, from the front (owner) or the back (thief)
+static int lock_pool_take(struct lock_pool_queue *q, int back, uint32_t *chunk) {
+    uint64_t r = atomic_load_explicit(&q->range, memory_order_relaxed);
+
+    for (;;) {
+        uint32_t first = (uint32_t)(r >> 32);
+        uint32_t last = (uint32_t)r;
+        uint64_t next;
+
+        if (first >= last) {
+            return 0;
+        }
+        if (back) {
+            *chunk = last - 1;
+            next = ((uint64_t)first << 32) | (last - 1);
+        }
+        else {
+            *chunk = first;
+            next = ((uint64_t)(first + 1) << 32) | last;
+        }
+        if (atomic_compare_exchange_weak_explicit(&q->range, &r, next, memory_order_acq_rel, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+}
+
+static void lock_pool_work(struct lock_pool *pool, int id) {
+    struct lock_pool_stats *st = pool->stats;
+    double t0 = now_seconds();
+    size_t items = 0, chunks = 0, stolen = 0;
+    uint32_t c;
+    int v;
+
+    for (;;) {
+        int got = lock_pool_take(&pool->queue[id], 0, &c);
+
+        for (v = 1; !got && v < pool->threads; v++) {
+            got = lock_pool_take(&pool->queue[(id + v) % pool->threads], 1, &c);
+            stolen += got;
+        }
+        if (!got) {
+            break;
+        }
+
+        size_t begin = (size_t)c * pool->run_chunk;
+        size_t end = (begin + pool->run_chunk < pool->count) ? begin + pool->run_chunk : pool->count;
+        pool->fn(pool->ctx, begin, end);
+        items += end - begin;
+        chunks++;
+    }
+
+    if (st != NULL) {
+        st->items[id] = items;
+        st->chunks[id] = chunks;
+        st->stolen[id] = stolen;
+        st->busy[id] = now_seconds() - t0;
+    }
+}
+
+static void *lock_pool_main(void *arg) {
+    struct lock_pool_worker *w = arg;
+    struct lock_pool *pool = w->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == seen && !pool->quit) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        lock_pool_work(pool, w->id);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static void lock_pool_pin(pthread_t tid, int id) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(id % (ncpu > 0 ? ncpu : 1), &set);
+    pthread_setaffinity_np(tid, sizeof(set), &set);
+}
+
+// Only one pool is live at a time (the worker slots are static). Returns NULL on failure.
+struct lock_pool *lock_pool_create(const struct lock_pool_config *cfg) {
+    struct lock_pool *pool = calloc(1, sizeof(*pool));
+    int i;
+
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    pool->threads = (cfg != NULL) ? cfg->threads : 0;
+    if (pool->threads <= 0) {
+        pool->threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (pool->threads < 1) {
+        pool->threads = 1;
+    }
+    if (pool->threads > LOCK_MAX_THREADS) {
+        pool->threads = LOCK_MAX_THREADS;
+    }
+    pool->chunk = (cfg != NULL && cfg->chunk > 0) ? cfg->chunk : 16384;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    if (cfg != NULL && cfg->pin) {
+        lock_pool_pin(pthread_self(), 0);
+    }
+    for (i = 1; i < pool->threads; i++) {
+        lock_pool_workers[i].pool = pool;
+        lock_pool_workers[i].id = i;
+        if (pthread_create(&pool->tid[i], NULL, lock_pool_main, &lock_pool_workers[i]) != 0) {
+            pool->threads = i;
+            break;
+        }
+        if (cfg != NULL && cfg->pin) {
+            lock_pool_pin(pool->tid[i], i);
+        }
+    }
+
+    return pool;
+}
+
+void lock_pool_destroy(struct lock_pool *pool) {
+    int i;
+
+    if (pool == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (i = 1; i < pool->threads; i++) {
+        pthread_join(pool->tid[i], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+// Runs fn over [0, count) on every worker in chunks of chunk items (0 for the pool's own
+// size) and returns when all chunks are done. stats may be NULL.
+void lock_pool_run_chunked(struct lock_pool *pool, size_t count, size_t chunk, lock_job_fn fn, void *ctx,
+                           struct lock_pool_stats *stats) {
+    size_t nchunks;
+    size_t per, extra;
+    size_t first = 0;
+    double t0 = now_seconds();
+    int i;
+
+    chunk = (chunk > 0) ? chunk : pool->chunk;
+    nchunks = (count + chunk - 1) / chunk;
+    //Chunk indices are 32-bit inside the queues; widen the chunks for this run only
+    if (nchunks > UINT32_MAX) {
+        chunk = (count + UINT32_MAX - 1) / UINT32_MAX;
+        nchunks = (count + chunk - 1) / chunk;
+    }
+    per = nchunks / pool->threads;
+    extra = nchunks % pool->threads;
+
+    for (i = 0; i < pool->threads; i++) {
+        size_t n = per + ((size_t)i < extra);
+        atomic_store(&pool->queue[i].range, ((uint64_t)first << 32) | (first + n));
+        first += n;
+    }
+
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->count = count;
+    pool->run_chunk = chunk;
+    pool->stats = stats;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->running = pool->threads - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    lock_pool_work(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    if (stats != NULL) {
+        stats->threads = pool->threads;
+        stats->seconds = now_seconds() - t0;
+    }
+}
+
+// lock_pool_run_chunked() with the pool's chunk size
+void lock_pool_run(struct lock_pool *pool, size_t count, lock_job_fn fn, void *ctx, struct lock_pool_stats *stats) {
+    lock_pool_run_chunked(pool, count, 0, fn, ctx, stats);
+}
+
+// unlocker_batch() spread across a pool
+struct unlocker_batch_job {
+    int N;
+    const int *S;
+    const int *E;
+    int *P;
+};
+
+static void unlocker_batch_chunk(void *ctx, size_t begin, size_t end) {
+    struct unlocker_batch_job *job = ctx;
+
+    unlocker_batch(job->N, job->S + begin, job->E + begin, job->P + begin, end - begin);
+}
+
+void unlocker_batch_parallel(struct lock_pool *pool, int N, const int *S, const int *E, int *P, size_t count, struct lock_pool_stats *stats) {
+    struct unlocker_batch_job job = { N, S, E, P };
+
+    lock_pool_run(pool, count, unlocker_batch_chunk, &job, stats);
+}
+
+// Range-cost index over one long (S, E) pair: the cost of wheels [l, r) in O(1) as the
+// difference of two prefix sums. Prefix sums are kept in two levels, a 64-bit base per
+// block of LOCK_RANGE_BLOCK wheels plus a 16-bit offset per wheel within its block (at
+// most 5 * 8191), so the index takes 2 bytes per wheel instead of 8. Blocks are scanned
+// in parallel on the pool, 16 wheels per SSE2 step, and only the block totals are summed
+// serially. An updatable index instead keeps a Fenwick tree (4 bytes per wheel, up to
+// UINT32_MAX / 5 wheels) derived in parallel from the prefix sums, which makes both
+// queries and single-wheel changes O(log N).
+#define LOCK_RANGE_BLOCK 8192
+
+struct lock_range_index {
+    size_t n;
+    uint64_t *base;         //cost of wheels [0, b * LOCK_RANGE_BLOCK), blocks + 1 entries
+    uint16_t *local;        //cost from the start of wheel i's block up to (not including) i
+    uint32_t *fen;          //Fenwick tree, 1-based; NULL when the index is static
+};
+
+struct lock_range_job {
+    struct lock_range_index *ix;
+    const char *S, *E;
+};
+
+// Exclusive prefix sums of wheel costs over each block in [begin, end)
+static void lock_range_scan(void *ctx, size_t begin, size_t end) {
+    struct lock_range_job *job = ctx;
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i zero = _mm_setzero_si128();
+    size_t b;
+
+    for (b = begin; b < end; b++) {
+        size_t i = b * LOCK_RANGE_BLOCK;
+        size_t stop = (i + LOCK_RANGE_BLOCK < job->ix->n) ? i + LOCK_RANGE_BLOCK : job->ix->n;
+        const char *S = job->S, *E = job->E;
+        uint16_t *out = job->ix->local;
+        __m128i carry = zero;
+        unsigned int sum;
+
+        for (; i + 16 <= stop; i += 16) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(S + i));
+            __m128i e = _mm_loadu_si128((const __m128i *)(E + i));
+            __m128i D = _mm_or_si128(_mm_subs_epu8(a, e), _mm_subs_epu8(e, a));
+            __m128i C = _mm_min_epu8(D, _mm_sub_epi8(ten, D));
+            __m128i lo = _mm_unpacklo_epi8(C, zero), hi = _mm_unpackhi_epi8(C, zero);
+            __m128i x = lo, y = hi;
+
+            //Inclusive scan of 8 lanes in three shift-adds, minus the lane itself
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+            x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+            y = _mm_add_epi16(y, _mm_slli_si128(y, 2));
+            y = _mm_add_epi16(y, _mm_slli_si128(y, 4));
+            y = _mm_add_epi16(y, _mm_slli_si128(y, 8));
+            _mm_storeu_si128((__m128i *)(out + i), _mm_add_epi16(carry, _mm_sub_epi16(x, lo)));
+            carry = _mm_add_epi16(carry, _mm_shuffle_epi32(_mm_shufflehi_epi16(x, 0xFF), 0xFF));
+            _mm_storeu_si128((__m128i *)(out + i + 8), _mm_add_epi16(carry, _mm_sub_epi16(y, hi)));
+            carry = _mm_add_epi16(carry, _mm_shuffle_epi32(_mm_shufflehi_epi16(y, 0xFF), 0xFF));
+        }
+        sum = (uint16_t)_mm_cvtsi128_si32(carry);
+        for (; i < stop; i++) {
+            out[i] = (uint16_t)sum;
+            sum += wheel_cost(S[i] - '0', E[i] - '0');
+        }
+        //Block total, turned into bases by the serial pass
+        job->ix->base[b + 1] = sum;
+    }
+}
+
+static inline uint64_t lock_range_static_prefix(const struct lock_range_index *ix, size_t i) {
+    return (i == ix->n) ? ix->base[(ix->n + LOCK_RANGE_BLOCK - 1) / LOCK_RANGE_BLOCK] : ix->base[i / LOCK_RANGE_BLOCK] + ix->local[i];
+}
+
+// fen[i] = cost of wheels (i - lowbit(i), i], 1-based
+static void lock_range_fenwick(void *ctx, size_t begin, size_t end) {
+    struct lock_range_index *ix = ((struct lock_range_job *)ctx)->ix;
+    size_t i;
+
+    for (i = begin + 1; i <= end; i++) {
+        ix->fen[i] = (uint32_t)(lock_range_static_prefix(ix, i) - lock_range_static_prefix(ix, i - (i & -i)));
+    }
+}
+
+// Builds the index for N-digit ASCII codes S and E on pool (NULL runs it on this thread).
+// Returns 0 on a non-digit, allocation failure or if an updatable index would be too long.
+int lock_range_build(struct lock_range_index *ix, struct lock_pool *pool, size_t N, const char *S, const char *E, int updatable) {
+    size_t blocks = (N + LOCK_RANGE_BLOCK - 1) / LOCK_RANGE_BLOCK, b;
+    struct lock_range_job job = { ix, S, E };
+
+    memset(ix, 0, sizeof(*ix));
+    if (updatable && N > UINT32_MAX / 5) {
+        return 0;
+    }
+    for (b = 0; b < N; b++) {
+        if ((unsigned char)(S[b] - '0') > 9 || (unsigned char)(E[b] - '0') > 9) {
+            return 0;
+        }
+    }
+    ix->n = N;
+    ix->base = calloc(blocks + 1, sizeof(uint64_t));
+    ix->local = malloc((N + 1) * sizeof(uint16_t));
+    if (updatable) {
+        ix->fen = malloc((N + 1) * sizeof(uint32_t));
+    }
+    if (ix->base == NULL || ix->local == NULL || (updatable && ix->fen == NULL)) {
+        free(ix->base);
+        free(ix->local);
+        free(ix->fen);
+        return 0;
+    }
+
+    if (pool != NULL) {
+        //One block per chunk: a block is already 8192 wheels of work
+        lock_pool_run_chunked(pool, blocks, 1, lock_range_scan, &job, NULL);
+    }
+    else {
+        lock_range_scan(&job, 0, blocks);
+    }
+    for (b = 1; b <= blocks; b++) {
+        ix->base[b] += ix->base[b - 1];
+    }
+
+    if (updatable) {
+        ix->fen[0] = 0;
+        if (pool != NULL) {
+            lock_pool_run(pool, N, lock_range_fenwick, &job, NULL);
+        }
+        else {
+            lock_range_fenwick(&job, 0, N);
+        }
+        //From here on the Fenwick tree is the only copy that stays current
+        free(ix->local);
+        ix->local = NULL;
+    }
+
+    return 1;
+}
+
+void lock_range_free(struct lock_range_index *ix) {
+    free(ix->base);
+    free(ix->local);
+    free(ix->fen);
+    memset(ix, 0, sizeof(*ix));
+}
+
+// Cost of wheels [0, i)
+static inline uint64_t lock_range_prefix(const struct lock_range_index *ix, size_t i) {
+    uint64_t P = 0;
+
+    if (ix->fen == NULL) {
+        return lock_range_static_prefix(ix, i);
+    }
+    for (; i > 0; i -= i & -i) {
+        P += ix->fen[i];
+    }
+    return P;
+}
+
+// Cost of wheels [l, r), 0 for an empty or out-of-range span
+static inline long long lock_range_cost(const struct lock_range_index *ix, size_t l, size_t r) {
+    r = (r < ix->n) ? r : ix->n;
+    return (l < r) ? (long long)(lock_range_prefix(ix, r) - lock_range_prefix(ix, l)) : 0;
+}
+
+// Wheel i now turns from digit s to digit e (updatable indexes only). Returns 0 otherwise.
+int lock_range_set(struct lock_range_index *ix, size_t i, int s, int e) {
+    int delta;
+
+    if (ix->fen == NULL || i >= ix->n) {
+        return 0;
+    }
+    delta = wheel_cost(s, e) - (int)lock_range_cost(ix, i, i + 1);
+    for (i++; i <= ix->n; i += i & -i) {
+        ix->fen[i] += (uint32_t)delta;
+    }
+    return 1;
+}
+
+// Builds static and updatable indexes, with and without pool, over lengths around the
+// block and SIMD edges and compares random ranges with a scalar prefix array, then does
+// the same after random updates. Returns the number of mismatches.
+int lock_range_check(struct lock_pool *pool, uint64_t seed) {
+    static const size_t lengths[] = { 0, 1, 15, 16, 17, LOCK_RANGE_BLOCK - 1, LOCK_RANGE_BLOCK, LOCK_RANGE_BLOCK + 1, 100000, 300007 };
+    struct lock_range_index ix;
+    struct lock_draws d;
+    size_t t, n, i, l, r;
+    long long *P;
+    char *S, *E;
+    int bad = 0, updatable, pooled, q;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (t = 0; t < sizeof(lengths) / sizeof(lengths[0]); t++) {
+        n = lengths[t];
+        S = malloc(n + 1);
+        E = malloc(n + 1);
+        P = malloc((n + 1) * sizeof(long long));
+        if (S == NULL || E == NULL || P == NULL) {
+            free(S);
+            free(E);
+            free(P);
+            return bad + 1;
+        }
+        for (i = 0; i < n; i++) {
+            S[i] = '0' + lock_draw(&d, 10);
+            E[i] = '0' + lock_draw(&d, 10);
+        }
+
+        for (updatable = 0; updatable < 2; updatable++) {
+            for (pooled = 0; pooled < 2; pooled++) {
+                if (!lock_range_build(&ix, pooled ? pool : NULL, n, S, E, updatable)) {
+                    bad++;
+                    continue;
+                }
+                //Updates go into S and E too, so the next build sees them
+                for (q = 0; q < ((updatable && n > 0) ? 2 : 1); q++) {
+                    if (q == 1) {
+                        for (i = 0; i < 500; i++) {
+                            size_t w = lock_draw_wide(&d, n);
+                            int s = lock_draw(&d, 10), e = lock_draw(&d, 10);
+
+                            S[w] = (char)('0' + s);
+                            E[w] = (char)('0' + e);
+                            lock_range_set(&ix, w, s, e);
+                        }
+                    }
+                    for (P[0] = 0, i = 0; i < n; i++) {
+                        P[i + 1] = P[i] + wheel_cost(S[i] - '0', E[i] - '0');
+                    }
+                    bad += (lock_range_cost(&ix, 0, n) != P[n]);
+                    for (i = 0; i < 2000; i++) {
+                        l = lock_draw_wide(&d, n + 1);
+                        r = lock_draw_wide(&d, n + 1);
+                        bad += (lock_range_cost(&ix, l, r) != ((l < r) ? P[r] - P[l] : 0));
+                    }
+                }
+                lock_range_free(&ix);
+            }
+        }
+        free(S);
+        free(E);
+        free(P);
+    }
+
+    return bad;
+}
+
+// Nearest-code search over a dictionary of N-digit codes (N <= 19) under the lock cost.
+// The codes are sorted once, which lays them out as the leaves of an implicit digit trie:
+// the codes sharing their first d digits are one contiguous run. A table over the first
+// few digits jumps straight to those runs, and deeper ones are found by binary search
+// inside the parent's run. Queries walk the trie depth first (k-nearest takes children in
+// order of the next wheel's cost, within-budget in digit order so its hits come out
+// sorted), carrying the cost of the digits fixed so far as a lower bound; a
+// subtree is dropped as soon as that bound can't beat the k-th best hit (or exceeds the
+// budget), and runs of LOCK_DICT_LEAF codes or fewer are just scanned. Pruning pays off
+// while the nearest codes are a few turns away; on sparse sets (10^7 codes of 16 digits)
+// far more of the trie survives the bound.
+#define LOCK_DICT_LEAF 16
+#define LOCK_DICT_TABLE 6       //at most 10^6 + 1 table entries
+
+struct lock_dict {
+    int N;
+    size_t count;
+    uint64_t *code;             //sorted, no duplicates
+    uint32_t *start;            //start[p] = first code whose top `levels` digits are >= p
+    int levels;
+    uint64_t pow10[20];
+};
+
+struct lock_hit {
+    uint64_t code;
+    int cost;
+};
+
+// Parallel sort: LSD radix sort on equal runs, then rounds of pairwise merges
+struct lock_sort_job {
+    uint64_t *a, *tmp;
+    size_t n, run;
+    int bits;
+};
+
+static void lock_sort_runs(void *ctx, size_t begin, size_t end) {
+    struct lock_sort_job *job = ctx;
+    size_t r;
+
+    for (r = begin; r < end; r++) {
+        size_t lo = r * job->run, hi = (lo + job->run < job->n) ? lo + job->run : job->n, i;
+        uint64_t *src = job->a + lo, *dst = job->tmp + lo;
+        int shift;
+
+        for (shift = 0; shift < job->bits; shift += 8) {
+            size_t cnt[257] = { 0 };
+            uint64_t *t;
+            int b;
+
+            for (i = 0; i < hi - lo; i++) {
+                cnt[((src[i] >> shift) & 0xFF) + 1]++;
+            }
+            for (b = 0; b < 256; b++) {
+                cnt[b + 1] += cnt[b];
+            }
+            for (i = 0; i < hi - lo; i++) {
+                dst[cnt[(src[i] >> shift) & 0xFF]++] = src[i];
+            }
+            t = src;
+            src = dst;
+            dst = t;
+        }
+        if (src != job->a + lo) {
+            memcpy(job->a + lo, src, (hi - lo) * sizeof(uint64_t));
+        }
+    }
+}
+
+// Merges runs 2m and 2m + 1 (of job->run codes each) from a into tmp
+static void lock_sort_merges(void *ctx, size_t begin, size_t end) {
+    struct lock_sort_job *job = ctx;
+    size_t m;
+
+    for (m = begin; m < end; m++) {
+        size_t lo = 2 * m * job->run;
+        size_t mid = (lo + job->run < job->n) ? lo + job->run : job->n;
+        size_t hi = (mid + job->run < job->n) ? mid + job->run : job->n;
+        size_t i = lo, j = mid, k = lo;
+
+        while (i < mid && j < hi) {
+            job->tmp[k++] = (job->a[j] < job->a[i]) ? job->a[j++] : job->a[i++];
+        }
+        memcpy(job->tmp + k, job->a + i, (mid - i) * sizeof(uint64_t));
+        k += mid - i;
+        memcpy(job->tmp + k, job->a + j, (hi - j) * sizeof(uint64_t));
+    }
+}
+
+// Sorts a[0, n) of values below 2^bits. Returns 0 on allocation failure.
+int lock_sort_u64(struct lock_pool *pool, uint64_t *a, size_t n, int bits) {
+    struct lock_sort_job job = { a, malloc(n * sizeof(uint64_t) + 1), n, n, bits };
+    size_t runs = (pool != NULL) ? (size_t)pool->threads : 1;
+
+    if (job.tmp == NULL) {
+        return 0;
+    }
+    job.run = (n + runs - 1) / runs;
+    job.run = (job.run > 0) ? job.run : 1;
+    runs = (n + job.run - 1) / job.run;
+
+    //A run or a merge is one item, so one chunk
+    if (pool != NULL) {
+        lock_pool_run_chunked(pool, runs, 1, lock_sort_runs, &job, NULL);
+    }
+    else {
+        lock_sort_runs(&job, 0, runs);
+    }
+    for (; runs > 1; runs = (runs + 1) / 2, job.run *= 2) {
+        uint64_t *t;
+
+        if (pool != NULL) {
+            lock_pool_run_chunked(pool, (runs + 1) / 2, 1, lock_sort_merges, &job, NULL);
+        }
+        else {
+            lock_sort_merges(&job, 0, (runs + 1) / 2);
+        }
+        t = job.a;
+        job.a = job.tmp;
+        job.tmp = t;
+    }
+    if (job.a != a) {
+        memcpy(a, job.a, n * sizeof(uint64_t));
+        job.tmp = job.a;
+    }
+    free(job.tmp);
+
+    return 1;
+}
+
+static size_t lock_dict_lower(const uint64_t *code, size_t lo, size_t hi, uint64_t v) {
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (code[mid] < v) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void lock_dict_table(void *ctx, size_t begin, size_t end) {
+    struct lock_dict *d = ctx;
+    uint64_t scale = d->pow10[d->N - d->levels];
+    size_t p;
+
+    for (p = begin; p < end; p++) {
+        d->start[p] = (uint32_t)lock_dict_lower(d->code, 0, d->count, p * scale);
+    }
+}
+
+// Builds the index over codes[0, count), each taken as its lowest N digits. pool may be
+// NULL. Returns 0 on allocation failure or bad N.
+int lock_dict_build(struct lock_dict *d, struct lock_pool *pool, int N, const uint64_t *codes, size_t count) {
+    size_t k, m;
+    int bits;
+
+    memset(d, 0, sizeof(*d));
+    if (N < 1 || N > 19 || count > UINT32_MAX) {
+        return 0;
+    }
+    d->N = N;
+    for (k = 0; k < 20; k++) {
+        d->pow10[k] = ipow(10, (int)k);
+    }
+    if ((d->code = malloc(count * sizeof(uint64_t) + 1)) == NULL) {
+        return 0;
+    }
+    for (k = 0; k < count; k++) {
+        d->code[k] = codes[k] % d->pow10[N];
+    }
+    bits = 64 - __builtin_clzll(d->pow10[N] - 1);
+    if (!lock_sort_u64(pool, d->code, count, bits)) {
+        free(d->code);
+        return 0;
+    }
+    for (k = 0, m = 0; k < count; k++) {
+        if (m == 0 || d->code[k] != d->code[m - 1]) {
+            d->code[m++] = d->code[k];
+        }
+    }
+    d->count = m;
+
+    //Enough table levels that a bottom-level run holds a few codes on average
+    while (d->levels < N && d->levels < LOCK_DICT_TABLE && d->pow10[d->levels + 1] * 4 <= d->count) {
+        d->levels++;
+    }
+    if ((d->start = malloc((d->pow10[d->levels] + 1) * sizeof(uint32_t))) == NULL) {
+        free(d->code);
+        return 0;
+    }
+    if (pool != NULL) {
+        lock_pool_run(pool, d->pow10[d->levels] + 1, lock_dict_table, d, NULL);
+    }
+    else {
+        lock_dict_table(d, 0, d->pow10[d->levels] + 1);
+    }
+
+    return 1;
+}
+
+void lock_dict_free(struct lock_dict *d) {
+    free(d->code);
+    free(d->start);
+    memset(d, 0, sizeof(*d));
+}
+
+struct lock_dict_search {
+    const struct lock_dict *d;
+    uint64_t S;
+    int q[20];                  //query digits, most significant first
+    //k nearest: max-heap on cost of the best so far
+    struct lock_hit *heap;
+    size_t k, have;
+    //within budget: hits go to out until it's full, all are counted
+    int budget;
+    struct lock_hit *out;
+    size_t max, found;
+};
+
+// Smallest cost a subtree still has to beat to be worth a visit
+static inline int lock_dict_bound(const struct lock_dict_search *s) {
+    if (s->heap == NULL) {
+        return s->budget + 1;
+    }
+    return (s->have < s->k) ? INT32_MAX : s->heap[0].cost;
+}
+
+static void lock_dict_hit(struct lock_dict_search *s, uint64_t code, int cost) {
+    size_t i, c;
+
+    if (s->heap == NULL) {
+        if (s->found < s->max) {
+            s->out[s->found].code = code;
+            s->out[s->found].cost = cost;
+        }
+        s->found++;
+        return;
+    }
+
+    if (s->have < s->k) {
+        //Sift up
+        for (i = s->have++; i > 0 && s->heap[(i - 1) / 2].cost < cost; i = (i - 1) / 2) {
+            s->heap[i] = s->heap[(i - 1) / 2];
+        }
+    }
+    else {
+        //Replace the worst and sift down
+        for (i = 0; (c = 2 * i + 1) < s->k; i = c) {
+            if (c + 1 < s->k && s->heap[c + 1].cost > s->heap[c].cost) {
+                c++;
+            }
+            if (s->heap[c].cost <= cost) {
+                break;
+            }
+            s->heap[i] = s->heap[c];
+        }
+    }
+    s->heap[i].code = code;
+    s->heap[i].cost = cost;
+}
+
+// Codes [lo, hi) share their first `depth` digits (prefix p), which cost acc
+static void lock_dict_walk(struct lock_dict_search *s, size_t lo, size_t hi, int depth, uint64_t p, int acc) {
+    const struct lock_dict *d = s->d;
+    static const int order[10] = { 0, 1, -1, 2, -2, 3, -3, 4, -4, 5 };
+    int j;
+
+    if (hi - lo <= LOCK_DICT_LEAF || depth == d->N) {
+        uint64_t rest = d->pow10[d->N - depth];
+        size_t k;
+
+        for (k = lo; k < hi; k++) {
+            int cost = acc + unlocker_u64(d->N - depth, d->code[k] % rest, s->S % rest);
+            if (cost < lock_dict_bound(s)) {
+                lock_dict_hit(s, d->code[k], cost);
+            }
+        }
+        return;
+    }
+
+    for (j = 0; j < 10; j++) {
+        int c = (s->heap != NULL) ? (s->q[depth] + order[j] + 10) % 10 : j;
+        int cost = acc + wheel_cost(s->q[depth], c);
+        uint64_t child = p * 10 + c, scale = d->pow10[d->N - depth - 1];
+        size_t clo, chi;
+
+        if (cost >= lock_dict_bound(s)) {
+            //Children in cost order: the rest are no better
+            if (s->heap != NULL) {
+                break;
+            }
+            continue;
+        }
+        if (depth + 1 <= d->levels) {
+            uint64_t t = d->pow10[d->levels - depth - 1];
+            clo = d->start[child * t];
+            chi = d->start[(child + 1) * t];
+        }
+        else {
+            clo = lock_dict_lower(d->code, lo, hi, child * scale);
+            chi = lock_dict_lower(d->code, clo, hi, (child + 1) * scale);
+        }
+        if (clo < chi) {
+            lock_dict_walk(s, clo, chi, depth + 1, child, cost);
+        }
+    }
+}
+
+static void lock_dict_prepare(struct lock_dict_search *s, const struct lock_dict *d, uint64_t S) {
+    int i;
+
+    memset(s, 0, sizeof(*s));
+    s->d = d;
+    s->S = S % d->pow10[d->N];
+    for (i = 0; i < d->N; i++) {
+        s->q[i] = (int)(s->S / d->pow10[d->N - 1 - i] % 10);
+    }
+}
+
+static int lock_hit_cmp(const void *a, const void *b) {
+    const struct lock_hit *x = a, *y = b;
+
+    if (x->cost != y->cost) {
+        return (x->cost > y->cost) - (x->cost < y->cost);
+    }
+    return (x->code > y->code) - (x->code < y->code);
+}
+
+// Up to k codes closest to S, cheapest first, into out. Among codes at the cost of the
+// k-th, which ones make the cut depends on search order. Returns how many were found.
+size_t lock_dict_nearest(const struct lock_dict *d, uint64_t S, size_t k, struct lock_hit *out) {
+    struct lock_dict_search s;
+
+    if (k == 0 || d->count == 0) {
+        return 0;
+    }
+    lock_dict_prepare(&s, d, S);
+    s.heap = out;
+    s.k = k;
+    lock_dict_walk(&s, 0, d->count, 0, 0, 0);
+    qsort(out, s.have, sizeof(struct lock_hit), lock_hit_cmp);
+
+    return s.have;
+}
+
+// Every code within budget of S; the lowest max of them go to out, in code order.
+// Returns how many there are in all.
+size_t lock_dict_within(const struct lock_dict *d, uint64_t S, int budget, struct lock_hit *out, size_t max) {
+    struct lock_dict_search s;
+
+    if (budget < 0 || d->count == 0) {
+        return 0;
+    }
+    lock_dict_prepare(&s, d, S);
+    s.budget = budget;
+    s.out = out;
+    s.max = max;
+    lock_dict_walk(&s, 0, d->count, 0, 0, 0);
+
+    return s.found;
+}
+
+// k-nearest for many queries on the pool: out[i * k ...] and found[i] for query i
+struct lock_dict_batch {
+    const struct lock_dict *d;
+    const uint64_t *S;
+    size_t k;
+    struct lock_hit *out;
+    size_t *found;
+};
+
+static void lock_dict_batch_chunk(void *ctx, size_t begin, size_t end) {
+    struct lock_dict_batch *job = ctx;
+    size_t i;
+
+    for (i = begin; i < end; i++) {
+        job->found[i] = lock_dict_nearest(job->d, job->S[i], job->k, job->out + i * job->k);
+    }
+}
+
+void lock_dict_nearest_batch(struct lock_pool *pool, const struct lock_dict *d, const uint64_t *S, size_t count, size_t k,
+                             struct lock_hit *out, size_t *found) {
+    struct lock_dict_batch job = { d, S, k, out, found };
+
+    if (pool != NULL) {
+        lock_pool_run(pool, count, lock_dict_batch_chunk, &job, NULL);
+    }
+    else {
+        lock_dict_batch_chunk(&job, 0, count);
+    }
+}
+
+// Random dictionaries of 1..8 digit codes (duplicates and high digits included), queried
+// against a full scan: k-nearest must return min(k, count) codes at their true costs
+// with the k-th cost right, within-budget the exact total and the lowest codes in code
+// order, and the pooled batch the same hits as single queries. Returns the number of
+// mismatches.
+#define LOCK_CHECK_QUERIES 32
+#define LOCK_CHECK_K 20
+
+int lock_dict_check(struct lock_pool *pool, uint64_t seed) {
+    struct lock_hit hits[LOCK_CHECK_K], within[LOCK_CHECK_K], batch[LOCK_CHECK_QUERIES * LOCK_CHECK_K];
+    uint64_t codes[4096], S[LOCK_CHECK_QUERIES];
+    size_t found[LOCK_CHECK_QUERIES], count, k, n, i, j;
+    struct lock_dict dict;
+    struct lock_draws d;
+    int bad = 0, trial, N, budget;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (trial = 0; trial < 64; trial++) {
+        N = 1 + trial % 8;
+        count = 1 + lock_draw_wide(&d, sizeof(codes) / sizeof(codes[0]));
+        for (i = 0; i < count; i++) {
+            codes[i] = lock_draw_wide(&d, ipow(10, 19));
+        }
+        if (!lock_dict_build(&dict, (trial & 1) ? pool : NULL, N, codes, count)) {
+            return bad + 1;
+        }
+        for (j = 1; j < dict.count; j++) {
+            bad += (dict.code[j - 1] >= dict.code[j]);
+        }
+        k = 1 + lock_draw_wide(&d, LOCK_CHECK_K);
+
+        for (i = 0; i < LOCK_CHECK_QUERIES; i++) {
+            size_t below = 0, at = 0, inside = 0, total;
+            int kth;
+
+            S[i] = lock_draw_wide(&d, ipow(10, N));
+            budget = lock_draw(&d, 10);
+            n = lock_dict_nearest(&dict, S[i], k, hits);
+            kth = (n > 0) ? hits[n - 1].cost : -1;
+            for (j = 0; j < n; j++) {
+                bad += (hits[j].cost != unlocker_u64(N, hits[j].code, S[i]) || (j > 0 && hits[j - 1].cost > hits[j].cost));
+            }
+            total = lock_dict_within(&dict, S[i], budget, within, LOCK_CHECK_K);
+            for (j = 0; j < dict.count; j++) {
+                int cost = unlocker_u64(N, dict.code[j], S[i]);
+
+                below += (cost < kth);
+                at += (cost == kth);
+                //Within-budget hits come in code order, as the dictionary does
+                if (cost <= budget && inside < LOCK_CHECK_K) {
+                    bad += (within[inside].code != dict.code[j] || within[inside].cost != cost);
+                }
+                inside += (cost <= budget);
+            }
+            bad += (n != ((dict.count < k) ? dict.count : k) || below >= n || below + at < n || total != inside);
+        }
+
+        //The batch on the pool gives the same hits as one query at a time
+        lock_dict_nearest_batch(pool, &dict, S, LOCK_CHECK_QUERIES, k, batch, found);
+        for (i = 0; i < LOCK_CHECK_QUERIES; i++) {
+            n = lock_dict_nearest(&dict, S[i], k, hits);
+            bad += (found[i] != n);
+            for (j = 0; j < n && j < found[i]; j++) {
+                bad += (batch[i * k + j].code != hits[j].code || batch[i * k + j].cost != hits[j].cost);
+            }
+        }
+        lock_dict_free(&dict);
+    }
+
+    return bad;
+}
+
+// Cost balls: the codes within k turns of S. Every wheel has the same cost generating
+// function whatever its digit, P(x) = 1 + 2x + 2x^2 + 2x^3 + 2x^4 + x^5 (one digit at 0
+// turns, two at each of 1..4, one at 5), so the ball's size only depends on N and k and
+// the number of codes at cost c is f_c = [x^c] P(x)^N. Those come from the recurrence for
+// powers of a polynomial, F = P^N => P F' = N P' F, which gives each f_c from the five
+// before it with small multipliers and one exact division:
+//
+//   c f_c = sum_{i=1..5} p_i ((N + 1) i - c) f_{c-i}
+//
+// That is O(k) bignum-by-word operations, but f_c has up to N digits, so each one touches
+// up to N/9 limbs and a whole ball costs O(k N / 9) limb steps. With k up to 5N/2 that is
+// quadratic in N, about 1.6 s for the middle ball of LOCK_BALL_MAX_DIGITS wheels on one
+// core, and four times that for each doubling. P is a palindrome, so f_c = f_{5N-c} and
+// balls past the middle are counted as 10^N minus the complement.
+#define LOCK_BIG_BASE 1000000000u
+#define LOCK_BALL_MAX_DIGITS 20000
+
+// Unsigned bignum, little-endian base 10^9 limbs
+struct lock_big {
+    size_t n, cap;
+    uint32_t *limb;
+};
+
+static int lock_big_reserve(struct lock_big *a, size_t cap) {
+    uint32_t *p;
+
+    if (cap <= a->cap) {
+        return 1;
+    }
+    if ((p = realloc(a->limb, cap * sizeof(uint32_t))) == NULL) {
+        return 0;
+    }
+    a->limb = p;
+    a->cap = cap;
+    return 1;
+}
+
+static void lock_big_set(struct lock_big *a, uint32_t v) {
+    a->n = 0;
+    if (v > 0) {
+        a->limb[a->n++] = v;
+    }
+}
+
+// acc += a * m; acc must have room for a->n + 3 limbs
+static void lock_big_muladd(struct lock_big *acc, const struct lock_big *a, uint64_t m) {
+    uint64_t carry = 0;
+    size_t i;
+
+    for (i = 0; i < a->n || carry != 0; i++) {
+        uint64_t t = carry + ((i < acc->n) ? acc->limb[i] : 0) + ((i < a->n) ? a->limb[i] * m : 0);
+        acc->limb[i] = (uint32_t)(t % LOCK_BIG_BASE);
+        carry = t / LOCK_BIG_BASE;
+    }
+    acc->n = (i > acc->n) ? i : acc->n;
+}
+
+// acc = sum of m[i] * a[i] for i < terms, which must come out nonnegative; acc needs room
+// for the longest a[i] + 2 limbs. Everything fits in int64 while |m[i]| < 10^8.
+static void lock_big_combine(struct lock_big *acc, struct lock_big *const *a, const int64_t *m, int terms) {
+    int64_t carry = 0;
+    size_t len = 0, l;
+    int i;
+
+    for (i = 0; i < terms; i++) {
+        len = (a[i]->n > len) ? a[i]->n : len;
+    }
+    for (l = 0; (l < len || carry != 0) && l < acc->cap; l++) {
+        int64_t t = carry;
+
+        for (i = 0; i < terms; i++) {
+            t += (l < a[i]->n) ? m[i] * a[i]->limb[l] : 0;
+        }
+        carry = t / LOCK_BIG_BASE;
+        t %= LOCK_BIG_BASE;
+        if (t < 0) {
+            t += LOCK_BIG_BASE;
+            carry--;
+        }
+        acc->limb[l] = (uint32_t)t;
+    }
+    acc->n = l;
+    while (acc->n > 0 && acc->limb[acc->n - 1] == 0) {
+        acc->n--;
+    }
+}
+
+// a -= b, for a >= b
+static void lock_big_sub(struct lock_big *a, const struct lock_big *b) {
+    int64_t borrow = 0;
+    size_t i;
+
+    for (i = 0; i < a->n; i++) {
+        int64_t t = (int64_t)a->limb[i] - ((i < b->n) ? b->limb[i] : 0) - borrow;
+        borrow = (t < 0);
+        a->limb[i] = (uint32_t)(t + (borrow ? LOCK_BIG_BASE : 0));
+    }
+    while (a->n > 0 && a->limb[a->n - 1] == 0) {
+        a->n--;
+    }
+}
+
+// a /= d, which must divide a exactly
+static void lock_big_div(struct lock_big *a, uint64_t d) {
+    uint64_t rem = 0;
+    size_t i;
+
+    for (i = a->n; i-- > 0;) {
+        uint64_t t = rem * LOCK_BIG_BASE + a->limb[i];
+        a->limb[i] = (uint32_t)(t / d);
+        rem = t % d;
+    }
+    while (a->n > 0 && a->limb[a->n - 1] == 0) {
+        a->n--;
+    }
+}
+
+void lock_big_free(struct lock_big *a) {
+    free(a->limb);
+    memset(a, 0, sizeof(*a));
+}
+
+// Decimal digits of a, malloc'd
+char *lock_big_str(const struct lock_big *a) {
+    char *s = malloc(a->n * 9 + 2), *p = s;
+    size_t i;
+
+    if (s == NULL) {
+        return NULL;
+    }
+    if (a->n == 0) {
+        strcpy(s, "0");
+        return s;
+    }
+    p += sprintf(p, "%u", a->limb[a->n - 1]);
+    for (i = a->n - 1; i-- > 0;) {
+        p += sprintf(p, "%09u", a->limb[i]);
+    }
+    return s;
+}
+
+// Number of N-digit codes within k turns of any fixed code, into out (zeroed or from an
+// earlier call). Returns 0 on allocation failure or for N over LOCK_BALL_MAX_DIGITS,
+// which keeps the quadratic count to a few seconds.
+int lock_ball_count(size_t N, long long k, struct lock_big *out) {
+    static const int64_t p[6] = { 1, 2, 2, 2, 2, 1 };
+    struct lock_big f[6] = { { 0 } }, next = { 0 };
+    size_t limbs = N / 9 + 4, c, i;
+    long long top = 5 * (long long)N;
+    int complement = 0, ok = 0;
+
+    if (N > LOCK_BALL_MAX_DIGITS || !lock_big_reserve(out, limbs)) {
+        return 0;
+    }
+    if (k < 0) {
+        lock_big_set(out, 0);
+        return 1;
+    }
+    //Past the middle, count the codes outside instead
+    if (k >= top) {
+        k = top;
+    }
+    else if (k > top / 2) {
+        k = top - k - 1;
+        complement = 1;
+    }
+
+    for (i = 0; i < 6; i++) {
+        if (!lock_big_reserve(&f[i], limbs)) {
+            goto done;
+        }
+    }
+    if (!lock_big_reserve(&next, limbs)) {
+        goto done;
+    }
+
+    //f[c % 6] holds f_c
+    lock_big_set(&f[0], 1);
+    lock_big_set(out, 1);
+    for (c = 1; c <= (size_t)k; c++) {
+        struct lock_big *prev[5];
+        int64_t m[5];
+        int terms = 0;
+
+        for (i = 1; i <= 5 && i <= c; i++, terms++) {
+            prev[terms] = &f[(c - i) % 6];
+            m[terms] = p[i] * ((int64_t)((N + 1) * i) - (int64_t)c);
+        }
+        lock_big_combine(&next, prev, m, terms);
+        lock_big_div(&next, c);
+        memcpy(f[c % 6].limb, next.limb, next.n * sizeof(uint32_t));
+        f[c % 6].n = next.n;
+        lock_big_muladd(out, &next, 1);
+    }
+
+    if (complement) {
+        //10^N = 10^(N mod 9) * (10^9)^(N / 9)
+        memset(next.limb, 0, (N / 9) * sizeof(uint32_t));
+        next.limb[N / 9] = (uint32_t)ipow(10, (int)(N % 9));
+        next.n = N / 9 + 1;
+        lock_big_sub(&next, out);
+        memcpy(out->limb, next.limb, next.n * sizeof(uint32_t));
+        out->n = next.n;
+    }
+    ok = 1;
+
+done:
+    for (i = 0; i < 6; i++) {
+        lock_big_free(&f[i]);
+    }
+    lock_big_free(&next);
+    return ok;
+}
+
+// Streams the codes within k turns of S in increasing order, one buffer reused throughout:
+//
+//   struct lock_ball_iter it;
+//   const char *code;
+//   lock_ball_begin(&it, N, S, k);
+//   while ((code = lock_ball_next(&it)) != NULL) { ... }
+//   lock_ball_end(&it);
+//
+// Any prefix that stays within budget extends to a code (the rest of S costs nothing), so
+// stepping never hits a dead end: bump the last wheel that can still go up within what its
+// prefix left over, then set every wheel after it to its lowest affordable digit.
+struct lock_ball_iter {
+    size_t n;
+    const char *S;
+    char *code;                 //NUL-terminated, valid until the next call
+    int *left;                  //budget left before wheel i
+    int state;                  //0 before the first code, 1 while stepping, 2 once done
+};
+
+// Returns 0 if S has a non-digit or on allocation failure
+int lock_ball_begin(struct lock_ball_iter *it, size_t N, const char *S, int k) {
+    size_t i;
+
+    memset(it, 0, sizeof(*it));
+    for (i = 0; i < N; i++) {
+        if ((unsigned char)(S[i] - '0') > 9) {
+            return 0;
+        }
+    }
+    it->n = N;
+    it->S = S;
+    it->code = malloc(N + 1);
+    it->left = malloc((N + 1) * sizeof(int));
+    if (it->code == NULL || it->left == NULL) {
+        free(it->code);
+        free(it->left);
+        return 0;
+    }
+    it->code[N] = '\0';
+    it->left[0] = k;
+    it->state = (k < 0) ? 2 : 0;
+    return 1;
+}
+
+// Lowest digit above `above` within r turns of s, 10 if none
+static inline int lock_ball_least(int s, int r, int above) {
+    int d;
+
+    for (d = above + 1; d < 10 && wheel_cost(s, d) > r; d++) {
+    }
+    return d;
+}
+
+static void lock_ball_fill(struct lock_ball_iter *it, size_t from) {
+    size_t j;
+
+    for (j = from; j < it->n; j++) {
+        int s = it->S[j] - '0', d = lock_ball_least(s, it->left[j], -1);
+
+        it->code[j] = (char)('0' + d);
+        it->left[j + 1] = it->left[j] - wheel_cost(s, d);
+    }
+}
+
+const char *lock_ball_next(struct lock_ball_iter *it) {
+    size_t i;
+
+    if (it->state != 1) {
+        if (it->state == 2) {
+            return NULL;
+        }
+        it->state = 1;
+        lock_ball_fill(it, 0);
+        return it->code;
+    }
+    for (i = it->n; i-- > 0;) {
+        int s = it->S[i] - '0', d;
+
+        //With nothing left to spend, wheel i is pinned to S
+        if (it->left[i] == 0) {
+            continue;
+        }
+        if ((d = lock_ball_least(s, it->left[i], it->code[i] - '0')) < 10) {
+            it->code[i] = (char)('0' + d);
+            it->left[i + 1] = it->left[i] - wheel_cost(s, d);
+            lock_ball_fill(it, i + 1);
+            return it->code;
+        }
+    }
+    it->state = 2;
+    return NULL;
+}
+
+void lock_ball_end(struct lock_ball_iter *it) {
+    free(it->code);
+    free(it->left);
+    memset(it, 0, sizeof(*it));
+}
+
+// Every ball around random centres of 1..6 digits, k from -1 to past 5N, against a full
+// scan of the 10^N codes: the count, and the streamed codes (each inside, strictly
+// increasing, as many as the count). Returns the number of mismatches.
+int lock_ball_check(uint64_t seed) {
+    uint64_t hist[32], inside, S, e, prev, n;
+    struct lock_big count = { 0 };
+    struct lock_ball_iter it;
+    struct lock_draws d;
+    char code[8], *s;
+    const char *c;
+    int bad = 0, N, t, k, i;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (N = 1; N <= 6; N++) {
+        for (t = 0; t < 2; t++) {
+            S = lock_draw_wide(&d, ipow(10, N));
+            snprintf(code, sizeof(code), "%0*llu", N, (unsigned long long)S);
+            memset(hist, 0, sizeof(hist));
+            for (e = 0; e < ipow(10, N); e++) {
+                hist[unlocker_u64(N, S, e)]++;
+            }
+
+            for (k = -1, inside = 0; k <= 5 * N + 1; k++) {
+                inside += (k >= 0 && k <= 5 * N) ? hist[k] : 0;
+                if (!lock_ball_count((size_t)N, k, &count) || (s = lock_big_str(&count)) == NULL) {
+                    bad++;
+                    continue;
+                }
+                bad += (strtoull(s, NULL, 10) != inside);
+                free(s);
+
+                if (!lock_ball_begin(&it, (size_t)N, code, k)) {
+                    bad++;
+                    continue;
+                }
+                for (n = 0, prev = 0; (c = lock_ball_next(&it)) != NULL; n++) {
+                    for (e = 0, i = 0; i < N; i++) {
+                        e = 10 * e + (uint64_t)(c[i] - '0');
+                    }
+                    bad += (unlocker_u64(N, S, e) > k || (n > 0 && e <= prev));
+                    prev = e;
+                }
+                bad += (n != inside);
+                lock_ball_end(&it);
+            }
+        }
+    }
+    lock_big_free(&count);
+
+    return bad;
+}
+
+// Exact cost distribution over random pairs from one of the workload distributions. The
+// wheels of a pair are independent, so the cost of N wheels is the leading wheel's cost
+// convolved with N - 1 copies of every other wheel's (for uniform digits 0..5 turns come
+// with probability .1 .2 .2 .2 .2 .1). Mean and variance are exact sums of the per-wheel
+// moments. The histogram is a direct convolution up to LOCK_DIST_DP_MAX wheels; past that
+// it's one FFT of each wheel, a pointwise power and one inverse FFT. That FFT only spans
+// mean +- 32 sqrt(N): each wheel adds at most 5, so by Hoeffding less than 1e-34 of the
+// mass lies outside, and letting the cyclic convolution wrap that around changes nothing a
+// double can hold. A million wheels then need a 2^16-point transform. cpow and the
+// transforms each cost a few ulps, but raising to the N - 1 power scales them by N, so
+// every entry is only good to O(N eps) absolute (around 1e-10 total at a million wheels);
+// the result is renormalised so that at least the probabilities sum to 1.
+#define LOCK_DIST_DP_MAX 1000
+
+struct lock_cost_dist {
+    size_t N;
+    double mean, var;           //exact
+    size_t lo, len;             //p[i] is the probability of cost lo + i
+    double *p;
+    int fft;                    //whether p came from the FFT (absolute error O(N eps))
+};
+
+// Per-wheel cost probabilities for dist, lead = the leading wheel. Returns 0 for a
+// distribution whose wheels aren't independent.
+static int lock_wheel_pmf(int dist, int lead, double pmf[6]) {
+    int s, e;
+
+    memset(pmf, 0, 6 * sizeof(double));
+    switch (dist) {
+    case LOCK_DIST_UNIFORM:
+    case LOCK_DIST_FIXED:
+        //Same draws as lock_workload_code(): 1-9 on the leading wheel of a fixed-width code
+        lead = lead && dist == LOCK_DIST_FIXED;
+        for (s = lead; s < 10; s++) {
+            for (e = lead; e < 10; e++) {
+                pmf[wheel_cost(s, e)] += 1.0 / ((10 - lead) * (10 - lead));
+            }
+        }
+        return 1;
+    case LOCK_DIST_WRAP:
+        for (s = 0; s < 10; s++) {
+            int lo = (s <= 3) ? s + 6 : 0, hi = (s <= 3) ? 9 : s - 6;
+
+            if (s == 4 || s == 5) {
+                continue;
+            }
+            for (e = lo; e <= hi; e++) {
+                pmf[wheel_cost(s, e)] += 1.0 / 8 / (hi - lo + 1);
+            }
+        }
+        return 1;
+    case LOCK_DIST_HALF:
+        pmf[5] = 1;
+        return 1;
+    default:
+        //Mixed widths make the wheels depend on each other through the padding
+        return 0;
+    }
+}
+
+// In-place radix-2 FFT, n a power of two; inverse leaves out the 1/n
+static void lock_fft(double complex *a, size_t n, int inverse) {
+    size_t i, j, len;
+
+    for (i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            double complex t = a[i];
+            a[i] = a[j];
+            a[j] = t;
+        }
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        double ang = 2 * M_PI / len * (inverse ? 1 : -1);
+        size_t half = len / 2;
+
+        for (j = 0; j < half; j++) {
+            //Twiddles straight from cexp rather than a running product, which drifts
+            double complex w = cexp(I * (ang * j));
+
+            for (i = 0; i < n; i += len) {
+                double complex u = a[i + j], v = a[i + j + half] * w;
+
+                a[i + j] = u + v;
+                a[i + j + half] = u - v;
+            }
+        }
+    }
+}
+
+// Distribution of the cost of N wheels. Returns 0 on allocation failure or a
+// distribution it can't do exactly (mixed).
+int lock_cost_dist(struct lock_cost_dist *cd, size_t N, int dist) {
+    double lead[6], rest[6], m1 = 0, m2 = 0, l1 = 0, l2 = 0;
+    size_t i, j, c;
+    int d;
+
+    memset(cd, 0, sizeof(*cd));
+    if (N == 0 || !lock_wheel_pmf(dist, 1, lead) || !lock_wheel_pmf(dist, 0, rest)) {
+        return 0;
+    }
+    for (d = 0; d < 6; d++) {
+        l1 += d * lead[d];
+        l2 += d * d * lead[d];
+        m1 += d * rest[d];
+        m2 += d * d * rest[d];
+    }
+    cd->N = N;
+    cd->mean = l1 + (N - 1) * m1;
+    cd->var = (l2 - l1 * l1) + (N - 1) * (m2 - m1 * m1);
+
+    if (N <= LOCK_DIST_DP_MAX) {
+        double *next;
+
+        cd->len = 5 * N + 1;
+        cd->p = calloc(cd->len, sizeof(double));
+        next = calloc(cd->len, sizeof(double));
+        if (cd->p == NULL || next == NULL) {
+            free(cd->p);
+            free(next);
+            return 0;
+        }
+        memcpy(cd->p, lead, sizeof(lead));
+        for (i = 1; i < N; i++) {
+            memset(next, 0, (5 * i + 6) * sizeof(double));
+            for (c = 0; c <= 5 * i; c++) {
+                for (d = 0; d < 6; d++) {
+                    next[c + d] += cd->p[c] * rest[d];
+                }
+            }
+            memcpy(cd->p, next, (5 * i + 6) * sizeof(double));
+        }
+        free(next);
+        return 1;
+    }
+
+    {
+        double half = 32 * sqrt((double)N) + 8, sum;
+        size_t M = 1;
+        double complex *a, *b;
+
+        while (M < 5 * N + 1 && M < 2 * (size_t)half + 1) {
+            M <<= 1;
+        }
+        //Costs lo .. lo + M - 1, shifted inside 0 .. 5N
+        if (M < 5 * N + 1) {
+            cd->lo = (cd->mean > M / 2) ? (size_t)cd->mean - M / 2 : 0;
+            cd->lo = (cd->lo + M > 5 * N + 1) ? 5 * N + 1 - M : cd->lo;
+        }
+        cd->len = (M < 5 * N + 1) ? M : 5 * N + 1;
+        cd->fft = 1;
+        a = calloc(M, sizeof(double complex));
+        b = calloc(M, sizeof(double complex));
+        cd->p = malloc(cd->len * sizeof(double));
+        if (a == NULL || b == NULL || cd->p == NULL) {
+            free(a);
+            free(b);
+            free(cd->p);
+            return 0;
+        }
+        for (d = 0; d < 6; d++) {
+            a[d] = rest[d];
+            b[d] = lead[d];
+        }
+        lock_fft(a, M, 0);
+        lock_fft(b, M, 0);
+        for (j = 0; j < M; j++) {
+            a[j] = b[j] * cpow(a[j], (double)(N - 1));
+        }
+        lock_fft(a, M, 1);
+        for (i = 0, sum = 0; i < cd->len; i++) {
+            //Round-off can leave the far tails a hair below zero
+            double v = creal(a[(cd->lo + i) % M]) / M;
+            cd->p[i] = (v > 0) ? v : 0;
+            sum += cd->p[i];
+        }
+        for (i = 0; i < cd->len; i++) {
+            cd->p[i] /= sum;
+        }
+        free(a);
+        free(b);
+    }
+
+    return 1;
+}
+
+void lock_cost_dist_free(struct lock_cost_dist *cd) {
+    free(cd->p);
+    memset(cd, 0, sizeof(*cd));
+}
+
+// Smallest cost whose cumulative probability reaches q
+size_t lock_cost_dist_quantile(const struct lock_cost_dist *cd, double q) {
+    double sum = 0;
+    size_t i;
+
+    for (i = 0; i + 1 < cd->len; i++) {
+        sum += cd->p[i];
+        if (sum >= q) {
+            break;
+        }
+    }
+    return cd->lo + i;
+}
+
+// One wheel's (s, e) outcomes under dist with their probabilities, drawn the way
+// lock_workload_code() draws them. Returns how many.
+static int lock_dist_wheel_pairs(int dist, int lead, int *s, int *e, double *w) {
+    int n = 0, a, b;
+
+    for (a = 0; a < 10; a++) {
+        for (b = 0; b < 10; b++) {
+            double p = 0;
+
+            if (dist == LOCK_DIST_WRAP) {
+                p = ((a <= 3 && b >= a + 6) || (a >= 6 && b <= a - 6)) ? 1.0 / 8 / ((a <= 3) ? 4 - a : a - 5) : 0;
+            }
+            else if (dist == LOCK_DIST_HALF) {
+                p = (b == (a + 5) % 10) ? 0.1 : 0;
+            }
+            else if (lead && dist == LOCK_DIST_FIXED) {
+                p = (a > 0 && b > 0) ? 1.0 / 81 : 0;
+            }
+            else {
+                p = 0.01;
+            }
+            if (p > 0) {
+                s[n] = a;
+                e[n] = b;
+                w[n++] = p;
+            }
+        }
+    }
+    return n;
+}
+
+// Every distribution against a full enumeration of its pairs for N = 1..3, scored with
+// unlocker_u64(); then the FFT path one wheel past LOCK_DIST_DP_MAX against a direct
+// convolution, held to the O(N eps) the FFT promises. Returns the number of mismatches.
+int lock_cost_dist_check(void) {
+    static double want[2][5 * (LOCK_DIST_DP_MAX + 1) + 1];
+    int ls[100], le[100], rs[100], re[100], nl, nr, dist, N, i, j, bad = 0;
+    double lw[100], rw[100], hist[16], lead[6], rest[6], mean, var;
+    struct lock_cost_dist cd;
+    size_t c, M = LOCK_DIST_DP_MAX + 1;
+
+    for (dist = 0; dist < LOCK_DISTS; dist++) {
+        if (dist == LOCK_DIST_MIXED) {
+            bad += (lock_cost_dist(&cd, 3, dist) != 0);
+            continue;
+        }
+        nl = lock_dist_wheel_pairs(dist, 1, ls, le, lw);
+        nr = lock_dist_wheel_pairs(dist, 0, rs, re, rw);
+        for (N = 1; N <= 3; N++) {
+            //Wheel 0 is the leading one; a pair is one outcome per wheel
+            memset(hist, 0, sizeof(hist));
+            for (i = 0; i < nl * ((N > 1) ? nr : 1) * ((N > 2) ? nr : 1); i++) {
+                uint64_t S = (uint64_t)ls[i % nl], E = (uint64_t)le[i % nl];
+                double p = lw[i % nl];
+                int rem = i / nl;
+
+                for (j = 1; j < N; j++, rem /= nr) {
+                    S = 10 * S + (uint64_t)rs[rem % nr];
+                    E = 10 * E + (uint64_t)re[rem % nr];
+                    p *= rw[rem % nr];
+                }
+                hist[unlocker_u64(N, S, E)] += p;
+            }
+            if (!lock_cost_dist(&cd, (size_t)N, dist)) {
+                bad++;
+                continue;
+            }
+            for (c = 0, mean = 0, var = 0; c <= 5 * (size_t)N; c++) {
+                double got = (c >= cd.lo && c < cd.lo + cd.len) ? cd.p[c - cd.lo] : 0;
+
+                bad += (fabs(got - hist[c]) > 1e-12);
+                mean += c * hist[c];
+                var += c * c * hist[c];
+            }
+            var -= mean * mean;
+            bad += (fabs(cd.mean - mean) > 1e-9 || fabs(cd.var - var) > 1e-9);
+            lock_cost_dist_free(&cd);
+        }
+    }
+
+    //want[N % 2] is the distribution of N wheels, built one wheel at a time
+    lock_wheel_pmf(LOCK_DIST_FIXED, 1, lead);
+    lock_wheel_pmf(LOCK_DIST_FIXED, 0, rest);
+    memset(want, 0, sizeof(want));
+    memcpy(want[1], lead, sizeof(lead));
+    for (N = 2; N <= (int)M; N++) {
+        memset(want[N % 2], 0, sizeof(want[0]));
+        for (c = 0; c <= 5 * (size_t)(N - 1); c++) {
+            for (j = 0; j < 6; j++) {
+                want[N % 2][c + j] += want[(N - 1) % 2][c] * rest[j];
+            }
+        }
+    }
+    if (!lock_cost_dist(&cd, M, LOCK_DIST_FIXED) || !cd.fft) {
+        return bad + 1;
+    }
+    for (c = 0, mean = 0; c <= 5 * M; c++) {
+        double got = (c >= cd.lo && c < cd.lo + cd.len) ? cd.p[c - cd.lo] : 0;
+
+        bad += (fabs(got - want[M % 2][c]) > M * 1e-15);
+        mean += got;
+    }
+    bad += (fabs(mean - 1) > 1e-12);
+    lock_cost_dist_free(&cd);
+
+    return bad;
+}
+
+// Shortest path around forbidden codes (deadends) for N <= 9 wheels, one turn of one
+// wheel per step. A deadend only matters if it lies on some shortest path, which is when
+// cost(S, d) + cost(d, E) == cost(S, E) (wheels turn independently, so the triangle
+// inequality is tight exactly wheel by wheel); with none there, the answer is the cost.
+// Otherwise it's a bidirectional BFS over the 10^N codes, growing whichever side has the
+// smaller frontier by one level at a time. Each side marks what it has seen in a bitset
+// (deadends are pre-marked in both, so they're never entered), and a level is split over
+// the pool: a code is claimed with an atomic fetch_or, and workers stage new codes in a
+// local buffer and copy it into the next frontier with one fetch_add per flush. The four
+// frontier queues are carved out of one arena mapped with MAP_NORESERVE, so only the
+// pages a search actually reaches are ever backed by memory. Once a frontier averages a
+// code per bitset word it is rebuilt in code order from a bitset of the level's new codes:
+// the 2N neighbour probes then sweep the bitsets in order instead of jumping around, which
+// is most of the time on 10^8 codes.
+#define LOCK_BFS_MAX_DIGITS 9
+#define LOCK_BFS_FLUSH 1024
+
+struct lock_bfs_stats {
+    int formula;                //answered from the cost, no search
+    int levels;                 //levels grown, both sides together
+    size_t visited;             //codes claimed by either side
+    size_t peak_frontier;
+    double seconds;
+};
+
+struct lock_bfs_job {
+    int N;
+    const uint32_t *cur;
+    uint32_t *next;
+    _Atomic size_t count;       //codes in next
+    _Atomic uint64_t *own, *other;
+    _Atomic uint64_t *fresh;    //codes claimed this level
+    atomic_int met;
+};
+
+static void lock_bfs_flush(struct lock_bfs_job *job, const uint32_t *buf, size_t n) {
+    size_t at = atomic_fetch_add_explicit(&job->count, n, memory_order_relaxed);
+
+    memcpy(job->next + at, buf, n * sizeof(uint32_t));
+}
+
+// Grows one side by a level over cur[begin, end)
+static void lock_bfs_expand(void *ctx, size_t begin, size_t end) {
+    struct lock_bfs_job *job = ctx;
+    uint32_t buf[LOCK_BFS_FLUSH];
+    size_t k, n = 0;
+
+    for (k = begin; k < end && !atomic_load_explicit(&job->met, memory_order_relaxed); k++) {
+        uint32_t x = job->cur[k], r = x, p = 1;
+        int i, m;
+
+        //Digits by constant division, lowest wheel first
+        for (i = 0; i < job->N; i++, r /= 10, p *= 10) {
+            uint32_t d = r % 10;
+
+            for (m = 0; m < 2; m++) {
+                uint32_t y = (m == 0) ? ((d == 9) ? x - 9 * p : x + p) : ((d == 0) ? x + 9 * p : x - p);
+                uint64_t bit = 1ull << (y & 63);
+
+                //Plain load first: most neighbours are already taken
+                if (atomic_load_explicit(&job->own[y >> 6], memory_order_relaxed) & bit) {
+                    continue;
+                }
+                if (atomic_load_explicit(&job->other[y >> 6], memory_order_relaxed) & bit) {
+                    atomic_store_explicit(&job->met, 1, memory_order_relaxed);
+                    continue;
+                }
+                if (atomic_fetch_or_explicit(&job->own[y >> 6], bit, memory_order_relaxed) & bit) {
+                    continue;
+                }
+                atomic_fetch_or_explicit(&job->fresh[y >> 6], bit, memory_order_relaxed);
+                buf[n++] = y;
+            }
+        }
+        if (n + 2 * LOCK_BFS_MAX_DIGITS > LOCK_BFS_FLUSH) {
+            lock_bfs_flush(job, buf, n);
+            n = 0;
+        }
+    }
+    lock_bfs_flush(job, buf, n);
+}
+
+// Fewest turns from S to E on N wheels avoiding dead[0, ndead), into *turns (-1 if E
+// can't be reached). pool may be NULL; st may be NULL. Returns 0 on bad input (N outside
+// 1..9, a code with more than N digits) or allocation failure.
+int lock_shortest(struct lock_pool *pool, int N, uint32_t S, uint32_t E, const uint32_t *dead, size_t ndead,
+                  long long *turns, struct lock_bfs_stats *st) {
+    struct lock_bfs_job job;
+    struct lock_bfs_stats local;
+    _Atomic uint64_t *seen[2], *fresh;
+    uint32_t *arena, *queue[2][2];
+    size_t states, words, count[2], k;
+    int depth[2] = { 0, 0 }, cost, blocked = 0, i;
+    double t0 = now_seconds();
+
+    st = (st != NULL) ? st : &local;
+    memset(st, 0, sizeof(*st));
+    if (N < 1 || N > LOCK_BFS_MAX_DIGITS) {
+        return 0;
+    }
+    states = ipow(10, N);
+    if (S >= states || E >= states) {
+        return 0;
+    }
+
+    //Deadends off every shortest path can't change the answer
+    cost = unlocker_u64(N, S, E);
+    for (k = 0; k < ndead; k++) {
+        if (dead[k] >= states) {
+            return 0;
+        }
+        if (unlocker_u64(N, S, dead[k]) + unlocker_u64(N, dead[k], E) == cost) {
+            blocked = 1;
+        }
+    }
+    if (!blocked) {
+        *turns = cost;
+        st->formula = 1;
+        st->seconds = now_seconds() - t0;
+        return 1;
+    }
+
+    words = states / 64 + 1;
+    seen[0] = calloc(words, sizeof(uint64_t));
+    seen[1] = calloc(words, sizeof(uint64_t));
+    fresh = calloc(words, sizeof(uint64_t));
+    arena = mmap(NULL, 4 * states * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (seen[0] == NULL || seen[1] == NULL || fresh == NULL || arena == MAP_FAILED) {
+        free(seen[0]);
+        free(seen[1]);
+        free(fresh);
+        if (arena != MAP_FAILED) {
+            munmap(arena, 4 * states * sizeof(uint32_t));
+        }
+        return 0;
+    }
+    for (i = 0; i < 4; i++) {
+        queue[i / 2][i % 2] = arena + i * states;
+    }
+    for (k = 0; k < ndead; k++) {
+        seen[0][dead[k] >> 6] |= 1ull << (dead[k] & 63);
+        seen[1][dead[k] >> 6] |= 1ull << (dead[k] & 63);
+    }
+
+    *turns = -1;
+    if (!((seen[0][S >> 6] >> (S & 63)) & 1) && !((seen[0][E >> 6] >> (E & 63)) & 1)) {
+        //Side 0 grows from S, side 1 from E; queue[s][0] is the current frontier
+        seen[0][S >> 6] |= 1ull << (S & 63);
+        seen[1][E >> 6] |= 1ull << (E & 63);
+        queue[0][0][0] = S;
+        queue[1][0][0] = E;
+        count[0] = count[1] = 1;
+        st->visited = 2;
+        job.N = N;
+        job.fresh = fresh;
+
+        while (*turns < 0 && count[0] > 0 && count[1] > 0) {
+            int s = (count[0] <= count[1]) ? 0 : 1;
+            uint32_t *t;
+
+            job.cur = queue[s][0];
+            job.next = queue[s][1];
+            job.own = seen[s];
+            job.other = seen[1 - s];
+            atomic_store(&job.count, 0);
+            atomic_store(&job.met, 0);
+            if (pool != NULL) {
+                lock_pool_run(pool, count[s], lock_bfs_expand, &job, NULL);
+            }
+            else {
+                lock_bfs_expand(&job, 0, count[s]);
+            }
+
+            st->levels++;
+            if (atomic_load(&job.met)) {
+                *turns = depth[0] + depth[1] + 1;
+                break;
+            }
+            t = queue[s][0];
+            queue[s][0] = queue[s][1];
+            queue[s][1] = t;
+            count[s] = atomic_load(&job.count);
+            if (count[s] >= words) {
+                uint32_t *q = queue[s][0];
+
+                for (k = 0; k < words; k++) {
+                    uint64_t b = atomic_load_explicit(&fresh[k], memory_order_relaxed);
+
+                    for (; b != 0; b &= b - 1) {
+                        *q++ = (uint32_t)(k * 64 + __builtin_ctzll(b));
+                    }
+                    atomic_store_explicit(&fresh[k], 0, memory_order_relaxed);
+                }
+            }
+            else {
+                for (k = 0; k < count[s]; k++) {
+                    atomic_store_explicit(&fresh[queue[s][0][k] >> 6], 0, memory_order_relaxed);
+                }
+            }
+            depth[s]++;
+            st->visited += count[s];
+            st->peak_frontier = (count[s] > st->peak_frontier) ? count[s] : st->peak_frontier;
+        }
+    }
+
+    free(seen[0]);
+    free(seen[1]);
+    free(fresh);
+    munmap(arena, 4 * states * sizeof(uint32_t));
+    st->seconds = now_seconds() - t0;
+
+    return 1;
+}
+
+// Plain one-sided BFS over all 10^N codes, the reference for lock_shortest_check()
+static long long lock_shortest_plain(int N, uint32_t S, uint32_t E, const uint8_t *dead, int *dist, uint32_t *queue) {
+    size_t states = ipow(10, N), head = 0, tail = 0, k;
+    int i, m;
+
+    for (k = 0; k < states; k++) {
+        dist[k] = -1;
+    }
+    if (dead[S] || dead[E]) {
+        return -1;
+    }
+    dist[S] = 0;
+    queue[tail++] = S;
+    while (head < tail) {
+        uint32_t x = queue[head++], p = 1;
+
+        for (i = 0; i < N; i++, p *= 10) {
+            uint32_t d = x / p % 10;
+
+            for (m = 0; m < 2; m++) {
+                uint32_t y = (m == 0) ? ((d == 9) ? x - 9 * p : x + p) : ((d == 0) ? x + 9 * p : x - p);
+
+                if (!dead[y] && dist[y] < 0) {
+                    dist[y] = dist[x] + 1;
+                    queue[tail++] = y;
+                }
+            }
+        }
+    }
+    return dist[E];
+}
+
+// 600 random instances of 1..5 wheels with 0-60% of the codes dead (every seventh with
+// S = E), half on the pool, against a plain BFS. Returns the number of mismatches.
+int lock_shortest_check(struct lock_pool *pool, uint64_t seed) {
+    static uint8_t dead[100000];
+    static uint32_t list[100000], queue[100000];
+    static int dist[100000];
+    struct lock_bfs_stats st;
+    struct lock_draws d;
+    size_t states, ndead, k;
+    uint32_t S, E;
+    long long turns;
+    int bad = 0, trial, N, density;
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (trial = 0; trial < 600; trial++) {
+        N = 1 + trial % 5;
+        states = ipow(10, N);
+        density = (int)lock_draw_wide(&d, 61);
+        for (k = 0, ndead = 0; k < states; k++) {
+            dead[k] = (lock_draw_wide(&d, 100) < (uint64_t)density);
+            if (dead[k]) {
+                list[ndead++] = (uint32_t)k;
+            }
+        }
+        S = (uint32_t)lock_draw_wide(&d, states);
+        E = (trial % 7 == 0) ? S : (uint32_t)lock_draw_wide(&d, states);
+        if (!lock_shortest((trial & 1) ? pool : NULL, N, S, E, list, ndead, &turns, &st)) {
+            bad++;
+            continue;
+        }
+        bad += (turns != lock_shortest_plain(N, S, E, dead, dist, queue));
+    }
+
+    return bad;
+}
+
+// Binary corpus of (S, E) pairs for jobs larger than RAM. Little-endian layout:
+//   header (64 bytes)
+//   offsets table, variable-width corpora only: count + 1 uint64 byte offsets into the payload
+//   payload, page aligned: per record the S code then the E code, same length, either ASCII
+//   digits or packed BCD (odd lengths padded with a zero nibble on both sides, which is
+//   cost-neutral)
+// Fixed-width records are all 2 * code_bytes long, so record k sits at k * 2 * code_bytes.
+#define LOCK_CORPUS_VERSION 1
+#define LOCK_CORPUS_BCD 1u
+#define LOCK_CORPUS_VARIABLE 2u
+
+struct lock_corpus_header {
+    char magic[8];          //"LOCKCORP"
+    uint32_t version;
+    uint32_t flags;
+    uint64_t count;         //pairs
+    uint64_t width;         //digits per code (the maximum, for variable-width)
+    uint64_t offsets;       //file offset of the offsets table, 0 for fixed-width
+    uint64_t payload;       //file offset of the payload
+    uint64_t payload_bytes;
+    uint64_t reserved;
+};
+
+struct lock_corpus {
+    const struct lock_corpus_header *h;
+    const uint8_t *base;
+    size_t size;
+    const uint64_t *offsets;
+    const uint8_t *payload;
+    size_t code_bytes;      //fixed-width only
+};
+
+static size_t lock_corpus_code_bytes(uint32_t flags, size_t digits) {
+    return (flags & LOCK_CORPUS_BCD) ? lock_bcd_bytes(digits) : digits;
+}
+
+// Record k's codes and their length in digits
+static inline size_t lock_corpus_record(const struct lock_corpus *c, size_t k, const uint8_t **S, const uint8_t **E) {
+    size_t bytes = c->code_bytes;
+
+    if (c->offsets != NULL) {
+        bytes = (c->offsets[k + 1] - c->offsets[k]) / 2;
+        *S = c->payload + c->offsets[k];
+    }
+    else {
+        *S = c->payload + k * 2 * bytes;
+    }
+    *E = *S + bytes;
+
+    return (c->h->flags & LOCK_CORPUS_BCD) ? 2 * bytes : bytes;
+}
+
+// Writes count generated pairs straight to disk, a record at a time, so the corpus can be
+// far larger than memory. Variable-width records drop the leading zeros both codes share.
+int lock_corpus_generate(const char *path, uint64_t seed, int dist, size_t count, size_t width, uint32_t flags) {
+    struct lock_corpus_header h;
+    struct lock_draws d;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char *S = malloc(width);
+    char *E = malloc(width);
+    uint8_t *rec = malloc(2 * width);
+    FILE *out = fopen(path, "wb");
+    FILE *offs = NULL;
+    uint64_t at = 0;
+    size_t k;
+    int ok = 1;
+
+    if (S == NULL || E == NULL || rec == NULL || out == NULL) {
+        ok = 0;
+        goto done;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "LOCKCORP", 8);
+    h.version = LOCK_CORPUS_VERSION;
+    h.flags = flags;
+    h.count = count;
+    h.width = width;
+    h.offsets = (flags & LOCK_CORPUS_VARIABLE) ? sizeof(h) : 0;
+    h.payload = sizeof(h) + ((flags & LOCK_CORPUS_VARIABLE) ? (count + 1) * sizeof(uint64_t) : 0);
+    h.payload = (h.payload + page - 1) / page * page;
+
+    //The offsets table goes through a second stream on the same file
+    if (flags & LOCK_CORPUS_VARIABLE) {
+        offs = fopen(path, "r+b");
+        if (offs == NULL || fseeko(offs, (off_t)h.offsets, SEEK_SET) != 0) {
+            ok = 0;
+            goto done;
+        }
+    }
+    if (fseeko(out, (off_t)h.payload, SEEK_SET) != 0) {
+        ok = 0;
+        goto done;
+    }
+
+    lock_rng_seed(&d.rng, seed);
+    d.next = 64;
+    d.left = 0;
+    for (k = 0; k < count && ok; k++) {
+        size_t skip = 0, n, bytes;
+
+        lock_workload_code(&d, dist, S, E, width);
+        if (flags & LOCK_CORPUS_VARIABLE) {
+            while (skip + 1 < width && S[skip] == '0' && E[skip] == '0') {
+                skip++;
+            }
+            ok = fwrite(&at, sizeof(at), 1, offs) == 1;
+        }
+        n = width - skip;
+        bytes = lock_corpus_code_bytes(flags, n);
+        if (flags & LOCK_CORPUS_BCD) {
+            lock_bcd_pack(rec, S + skip, n);
+            lock_bcd_pack(rec + bytes, E + skip, n);
+        }
+        else {
+            memcpy(rec, S + skip, n);
+            memcpy(rec + n, E + skip, n);
+        }
+        ok = ok && fwrite(rec, 1, 2 * bytes, out) == 2 * bytes;
+        at += 2 * bytes;
+    }
+    if (flags & LOCK_CORPUS_VARIABLE) {
+        ok = ok && fwrite(&at, sizeof(at), 1, offs) == 1;
+    }
+
+    h.payload_bytes = at;
+    ok = ok && fseeko(out, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, out) == 1;
+
+done:
+    if (offs != NULL && fclose(offs) != 0) {
+        ok = 0;
+    }
+    if (out != NULL && fclose(out) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        remove(path);
+    }
+    free(S);
+    free(E);
+    free(rec);
+
+    return ok;
+}
+
+// Whether a variable-width corpus's offsets table describes records inside the payload:
+// starting at 0, never going backwards, two equal-length codes per record. Records are
+// read without bounds checks after this, so the file is only trusted once it passes.
+static int lock_corpus_offsets_ok(const struct lock_corpus *c) {
+    size_t k;
+
+    if (c->offsets[0] != 0 || c->offsets[c->h->count] > c->h->payload_bytes) {
+        return 0;
+    }
+    for (k = 0; k < c->h->count; k++) {
+        if (c->offsets[k + 1] < c->offsets[k] || (c->offsets[k + 1] - c->offsets[k]) % 2 != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Maps a corpus read-only with sequential read-ahead (and huge pages where the filesystem
+// allows them). Returns 0 if the file can't be mapped or isn't a valid corpus.
+int lock_corpus_open(struct lock_corpus *c, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    void *base;
+
+    if (fd < 0) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct lock_corpus_header)) {
+        close(fd);
+        return 0;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+    madvise(base, (size_t)st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(base, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+
+    c->base = base;
+    c->size = (size_t)st.st_size;
+    c->h = base;
+    c->offsets = (c->h->offsets != 0) ? (const uint64_t *)(c->base + c->h->offsets) : NULL;
+    c->payload = c->base + c->h->payload;
+    c->code_bytes = lock_corpus_code_bytes(c->h->flags, c->h->width);
+
+    if (memcmp(c->h->magic, "LOCKCORP", 8) != 0 || c->h->version != LOCK_CORPUS_VERSION ||
+        c->h->payload > c->size || c->h->payload_bytes > c->size - c->h->payload ||
+        //Divide rather than multiply: count comes from the file and may be anything
+        (c->offsets == NULL && c->code_bytes > 0 && c->h->count > c->h->payload_bytes / (2 * c->code_bytes)) ||
+        (c->offsets != NULL && (c->h->offsets % sizeof(uint64_t) != 0 || c->h->offsets > c->h->payload ||
+                                c->h->count >= (c->h->payload - c->h->offsets) / sizeof(uint64_t) ||
+                                !lock_corpus_offsets_ok(c)))) {
+        munmap(base, c->size);
+        return 0;
+    }
+
+    return 1;
+}
+
+void lock_corpus_close(struct lock_corpus *c) {
+    munmap((void *)c->base, c->size);
+}
+
+// Result file: a 32-byte header, then one uint32 cost per pair (enough for codes up to
+// ~858 million digits), written in place through a shared mapping
+struct lock_results_header {
+    char magic[8];          //"LOCKCOST"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t reserved2;
+};
+
+struct lock_results {
+    uint8_t *base;
+    size_t size;
+    uint32_t *cost;
+};
+
+int lock_results_create(struct lock_results *r, const char *path, size_t count) {
+    struct lock_results_header h;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    void *base;
+
+    if (fd < 0) {
+        return 0;
+    }
+    r->size = sizeof(h) + count * sizeof(uint32_t);
+    if (ftruncate(fd, (off_t)r->size) != 0) {
+        close(fd);
+        return 0;
+    }
+    base = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return 0;
+    }
+    madvise(base, r->size, MADV_SEQUENTIAL);
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, "LOCKCOST", 8);
+    h.version = 1;
+    h.count = count;
+    memcpy(base, &h, sizeof(h));
+
+    r->base = base;
+    r->cost = (uint32_t *)(r->base + sizeof(h));
+
+    return 1;
+}
+
+// Flushes the costs to disk and unmaps; returns 0 if the flush failed
+int lock_results_close(struct lock_results *r) {
+    int ok = msync(r->base, r->size, MS_SYNC) == 0;
+
+    munmap(r->base, r->size);
+    return ok;
+}
+
+// Scores every record straight out of the mapping on the pool
+struct lock_corpus_job {
+    const struct lock_corpus *c;
+    uint32_t *cost;
+};
+
+static void lock_corpus_chunk(void *ctx, size_t begin, size_t end) {
+    struct lock_corpus_job *job = ctx;
+    const struct lock_corpus *c = job->c;
+    int bcd = (c->h->flags & LOCK_CORPUS_BCD) != 0;
+    size_t k;
+
+    for (k = begin; k < end; k++) {
+        const uint8_t *S, *E;
+        size_t n = lock_corpus_record(c, k, &S, &E);
+
+        job->cost[k] = (uint32_t)(bcd ? unlocker_bcd(n, S, E) : lock_cost(n, (const char *)S, (const char *)E));
+    }
+}
+
+void lock_corpus_score(struct lock_pool *pool, const struct lock_corpus *c, uint32_t *cost, struct lock_pool_stats *stats) {
+    struct lock_corpus_job job = { c, cost };
+
+    lock_pool_run(pool, c->h->count, lock_corpus_chunk, &job, stats);
+}
+
+// Text filter: "S E" lines in (any whitespace between, codes of any length), one cost per
+// line out. Input is read in large blocks, lines are found with memchr and digit runs with
+// SSE2, and costs are formatted two digits at a time into a large output buffer, so nothing
+// is allocated per line. Codes of different lengths are right-aligned as integers would
+// be (the shorter one gets leading zeros). A malformed line gives -1; blank lines are skipped.
+#define LOCK_IO_BLOCK (1 << 20)
+
+static const char lock_zeros[4096] = { [0 ... 4095] = '0' };
+
+// Cost between right-aligned codes of different lengths
+long long lock_cost_aligned(const char *S, size_t ns, const char *E, size_t ne) {
+    const char *hi = (ns > ne) ? S : E;
+    size_t n = (ns < ne) ? ns : ne;
+    size_t extra = (ns > ne) ? ns - ne : ne - ns;
+    long long P = lock_cost(n, S + ns - n, E + ne - n);
+    size_t k, m;
+
+    //Leading digits of the longer code turn against implied zeros
+    for (k = 0; k < extra; k += m) {
+        m = (extra - k < sizeof(lock_zeros)) ? extra - k : sizeof(lock_zeros);
+        P += lock_cost(m, hi + k, lock_zeros);
+    }
+
+    return P;
+}
+
+// First byte in [p, end) that isn't a digit
+static inline const char *lock_scan_digits(const char *p, const char *end) {
+    const __m128i zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+
+    for (; p + 16 <= end; p += 16) {
+        __m128i t = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)p), zero);
+        unsigned m = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(t, nine), t)) & 0xFFFF;
+        if (m != 0) {
+            return p + __builtin_ctz(m);
+        }
+    }
+    while (p < end && (unsigned char)(*p - '0') <= 9) {
+        p++;
+    }
+
+    return p;
+}
+
+// Cost of n <= 16 wheels in one SSE2 step. Reads 16 bytes from S and E whatever n is, so
+// the caller's buffer needs that much slack past the codes.
+static inline int lock_cost_short(const char *S, const char *E, size_t n) {
+    const __m128i lane = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i a = _mm_loadu_si128((const __m128i *)S);
+    __m128i b = _mm_loadu_si128((const __m128i *)E);
+    __m128i D = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+    __m128i C = _mm_min_epu8(D, _mm_sub_epi8(_mm_set1_epi8(10), D));
+
+    C = _mm_and_si128(C, _mm_cmpgt_epi8(_mm_set1_epi8((char)n), lane));
+    C = _mm_sad_epu8(C, _mm_setzero_si128());
+    return _mm_cvtsi128_si32(C) + _mm_extract_epi16(C, 4);
+}
+
+static inline const char *lock_skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\v' || *p == '\f')) {
+        p++;
+    }
+    return p;
+}
+
+struct lock_out {
+    int fd;
+    char *buf;
+    size_t len;
+    int err;
+};
+
+static int lock_write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 1;
+}
+
+static void lock_out_flush(struct lock_out *o) {
+    if (o->len > 0 && !o->err && !lock_write_all(o->fd, o->buf, o->len)) {
+        o->err = 1;
+    }
+    o->len = 0;
+}
+
+// Appends v and a newline
+static inline void lock_out_cost(struct lock_out *o, long long v) {
+    char tmp[24];
+    char *q = tmp + sizeof(tmp);
+    uint64_t u = (v < 0) ? (uint64_t)-v : (uint64_t)v;
+
+    if (o->len + sizeof(tmp) > LOCK_IO_BLOCK) {
+        lock_out_flush(o);
+    }
+
+    *--q = '\n';
+    while (u >= 100) {
+        uint64_t d = u % 100;
+        u /= 100;
+        q -= 2;
+        memcpy(q, &digit_pairs[2 * d], 2);
+    }
+    if (u >= 10) {
+        q -= 2;
+        memcpy(q, &digit_pairs[2 * u], 2);
+    }
+    else {
+        *--q = '0' + (char)u;
+    }
+    if (v < 0) {
+        *--q = '-';
+    }
+
+    memcpy(o->buf + o->len, q, (size_t)(tmp + sizeof(tmp) - q));
+    o->len += (size_t)(tmp + sizeof(tmp) - q);
+}
+
+// Bit i set when q[i] is a newline, i < 64
+static inline uint64_t lock_newlines(const char *q) {
+    const __m128i nl = _mm_set1_epi8('\n');
+    uint64_t m0 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)q), nl));
+    uint64_t m1 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(q + 16)), nl));
+    uint64_t m2 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(q + 32)), nl));
+    uint64_t m3 = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(q + 48)), nl));
+
+    return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+struct lock_stream_stats {
+    size_t bytes;
+    size_t lines;
+    size_t bad;
+    double seconds;
+};
+
+static void lock_stream_line(struct lock_out *o, const char *p, const char *end, struct lock_stream_stats *st) {
+    const char *S, *E, *s_end, *e_end;
+
+    p = lock_skip_blanks(p, end);
+    if (p == end) {
+        return;
+    }
+    S = p;
+    s_end = lock_scan_digits(S, end);
+    E = lock_skip_blanks(s_end, end);
+    e_end = lock_scan_digits(E, end);
+
+    if (s_end == S || e_end == E || E == s_end || lock_skip_blanks(e_end, end) != end) {
+        lock_out_cost(o, -1);
+        st->bad++;
+    }
+    else if (s_end - S == e_end - E && s_end - S <= 16) {
+        lock_out_cost(o, lock_cost_short(S, E, (size_t)(s_end - S)));
+    }
+    else {
+        lock_out_cost(o, lock_cost_aligned(S, (size_t)(s_end - S), E, (size_t)(e_end - E)));
+    }
+    st->lines++;
+}
+
+// Returns 0 on a read or write error
+int lock_stream(int in, int out, struct lock_stream_stats *st) {
+    struct lock_out o = { out, malloc(LOCK_IO_BLOCK), 0, 0 };
+    size_t cap = LOCK_IO_BLOCK, have = 0;
+    char *buf = malloc(cap + 64);
+    double t0 = now_seconds();
+    int ok = 1;
+
+    memset(st, 0, sizeof(*st));
+    if (buf == NULL || o.buf == NULL) {
+        free(buf);
+        free(o.buf);
+        return 0;
+    }
+
+    for (;;) {
+        //A line longer than the buffer makes it grow; that's amortized, not per line.
+        //The 64 spare bytes past cap let lock_cost_short() read past a code.
+        if (have == cap) {
+            char *bigger = realloc(buf, 2 * cap + 64);
+            if (bigger == NULL) {
+                ok = 0;
+                break;
+            }
+            buf = bigger;
+            cap *= 2;
+        }
+
+        ssize_t n = read(in, buf + have, cap - have);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ok = 0;
+            break;
+        }
+        st->bytes += (size_t)n;
+        if (n == 0) {
+            //Last line without a newline
+            if (have > 0) {
+                lock_stream_line(&o, buf, buf + have, st);
+            }
+            break;
+        }
+        have += (size_t)n;
+
+        //Newlines are found 64 bytes at a time as a bitmask, then walked bit by bit
+        char *p = buf, *end = buf + have, *q = buf;
+        for (; q + 64 <= end; q += 64) {
+            uint64_t nl = lock_newlines(q);
+            while (nl != 0) {
+                char *e = q + __builtin_ctzll(nl);
+                lock_stream_line(&o, p, e, st);
+                p = e + 1;
+                nl &= nl - 1;
+            }
+        }
+        while ((q = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+            lock_stream_line(&o, p, q, st);
+            p = q + 1;
+        }
+        have = (size_t)(end - p);
+        memmove(buf, p, have);
+    }
+
+    lock_out_flush(&o);
+    ok = ok && !o.err;
+    st->seconds = now_seconds() - t0;
+
+    free(buf);
+    free(o.buf);
+
+    return ok;
+}
+
+// Pipelined scoring of a fixed-width corpus file without mapping it: a ring of reusable
+// buffers moves through read -> compute -> write. The driver thread keeps several reads in
+// flight through io_uring (or, where io_uring isn't available, through helper threads
+// doing pread/pwrite), worker threads score filled buffers, and finished costs are written
+// back asynchronously to a result file in the lock_results format. Every completion, I/O
+// or compute, bumps one eventfd, which is the only thing the driver ever blocks on.
+// Time spent waiting is recorded per stage, so a run shows whether it is I/O- or
+// compute-bound.
+enum { LOCK_IO_READ, LOCK_IO_WRITE };
+
+struct lock_uring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring, *cq_ring;
+    size_t sq_size, cq_size, sqes_size;
+    unsigned queued;
+};
+
+static int lock_uring_init(struct lock_uring *u, unsigned entries, int efd) {
+    struct io_uring_params p;
+
+    memset(&p, 0, sizeof(p));
+    memset(u, 0, sizeof(*u));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0) {
+        return 0;
+    }
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sq_ring = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    u->cq_ring = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sq_ring == MAP_FAILED || u->cq_ring == MAP_FAILED || (void *)u->sqes == MAP_FAILED ||
+        syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_EVENTFD, &efd, 1) != 0) {
+        if (u->sq_ring != MAP_FAILED) munmap(u->sq_ring, u->sq_size);
+        if (u->cq_ring != MAP_FAILED) munmap(u->cq_ring, u->cq_size);
+        if ((void *)u->sqes != MAP_FAILED) munmap(u->sqes, u->sqes_size);
+        close(u->fd);
+        return 0;
+    }
+
+    u->sq_head = (unsigned *)((char *)u->sq_ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ring + p.sq_off.array);
+    u->cq_head = (unsigned *)((char *)u->cq_ring + p.cq_off.head);
+    u->cq_tail = (unsigned *)((char *)u->cq_ring + p.cq_off.tail);
+    u->cq_mask = (unsigned *)((char *)u->cq_ring + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)((char *)u->cq_ring + p.cq_off.cqes);
+
+    return 1;
+}
+
+static void lock_uring_exit(struct lock_uring *u) {
+    munmap(u->sq_ring, u->sq_size);
+    munmap(u->cq_ring, u->cq_size);
+    munmap(u->sqes, u->sqes_size);
+    close(u->fd);
+}
+
+// Queues one vectored read or write; the ring is sized so it can't be full
+static void lock_uring_queue(struct lock_uring *u, int op, int fd, const struct iovec *iov, uint64_t off, uint64_t tag) {
+    unsigned tail = *u->sq_tail;
+    unsigned i = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (op == LOCK_IO_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = 1;
+    sqe->off = off;
+    sqe->user_data = tag;
+    u->sq_array[i] = i;
+    __atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    u->queued++;
+}
+
+static int lock_uring_submit(struct lock_uring *u) {
+    while (u->queued > 0) {
+        int n = (int)syscall(__NR_io_uring_enter, u->fd, u->queued, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            return 0;
+        }
+        u->queued -= (unsigned)n;
+    }
+    return 1;
+}
+
+// Non-blocking; returns 0 when the completion queue is empty
+static int lock_uring_reap(struct lock_uring *u, uint64_t *tag, int *res) {
+    unsigned head = *u->cq_head;
+
+    if (head == __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *tag = u->cqes[head & *u->cq_mask].user_data;
+    *res = u->cqes[head & *u->cq_mask].res;
+    __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+struct lock_pipe_buf {
+    uint8_t *in;
+    uint32_t *out;
+    size_t first;           //first record
+    size_t n;               //records
+    int op;
+    size_t done;            //bytes of the current op already transferred
+    struct iovec iov;
+    double t_submit;
+    double t_queued;
+};
+
+// Fixed-size FIFO of buffer indices
+struct lock_fifo {
+    int *item;
+    int cap, head, len;
+};
+
+static void lock_fifo_push(struct lock_fifo *f, int v) {
+    f->item[(f->head + f->len++) % f->cap] = v;
+}
+
+static int lock_fifo_pop(struct lock_fifo *f) {
+    int v = f->item[f->head];
+
+    f->head = (f->head + 1) % f->cap;
+    f->len--;
+    return v;
+}
+
+struct lock_pipe_stats {
+    const char *engine;
+    size_t pairs;
+    size_t bytes_read;
+    double seconds;
+    double read_s;          //summed time reads were in flight
+    double write_s;
+    double driver_wait_s;   //driver blocked with nothing to hand out
+    double queue_wait_s;    //filled buffers waiting for a free worker (compute-bound)
+    double worker_wait_s;   //workers idle waiting for data (I/O-bound)
+    int workers;
+};
+
+struct lock_pipe {
+    const struct lock_corpus_header *h;
+    int in, out, efd;
+    int uring;
+    struct lock_uring u;
+    size_t rec_bytes;
+    int nbufs;
+    struct lock_pipe_buf *buf;
+
+    pthread_mutex_t lock;
+    pthread_cond_t filled_cv;
+    pthread_cond_t io_cv;
+    struct lock_fifo filled;    //read, waiting for a worker
+    struct lock_fifo scored;    //computed, waiting for the driver to write
+    struct lock_fifo io_todo;   //thread engine: ops waiting for an I/O thread
+    struct lock_fifo io_done;   //thread engine: finished ops
+    int *io_res;
+    int quit;
+
+    struct lock_pipe_stats *st;
+};
+
+static void lock_pipe_kick(struct lock_pipe *p) {
+    uint64_t one = 1;
+
+    while (write(p->efd, &one, sizeof(one)) < 0 && errno == EINTR) {
+    }
+}
+
+// Fallback engine: blocking pread/pwrite on helper threads
+static void *lock_pipe_io_thread(void *arg) {
+    struct lock_pipe *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->io_todo.len == 0 && !p->quit) {
+            pthread_cond_wait(&p->io_cv, &p->lock);
+        }
+        if (p->quit) {
+            break;
+        }
+        int i = lock_fifo_pop(&p->io_todo);
+        struct lock_pipe_buf *b = &p->buf[i];
+        pthread_mutex_unlock(&p->lock);
+
+        off_t off = (b->op == LOCK_IO_READ) ? (off_t)(p->h->payload + b->first * p->rec_bytes)
+                                            : (off_t)(sizeof(struct lock_results_header) + b->first * sizeof(uint32_t));
+        ssize_t r = (b->op == LOCK_IO_READ) ? pread(p->in, b->iov.iov_base, b->iov.iov_len, off + (off_t)b->done)
+                                            : pwrite(p->out, b->iov.iov_base, b->iov.iov_len, off + (off_t)b->done);
+
+        pthread_mutex_lock(&p->lock);
+        p->io_res[i] = (r < 0) ? -errno : (int)r;
+        lock_fifo_push(&p->io_done, i);
+        lock_pipe_kick(p);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+static void lock_pipe_submit(struct lock_pipe *p, int i) {
+    struct lock_pipe_buf *b = &p->buf[i];
+    size_t len = (b->op == LOCK_IO_READ) ? b->n * p->rec_bytes : b->n * sizeof(uint32_t);
+    uint64_t off = (b->op == LOCK_IO_READ) ? p->h->payload + b->first * p->rec_bytes
+                                           : sizeof(struct lock_results_header) + b->first * sizeof(uint32_t);
+
+    b->iov.iov_base = ((b->op == LOCK_IO_READ) ? (uint8_t *)b->in : (uint8_t *)b->out) + b->done;
+    b->iov.iov_len = len - b->done;
+    if (b->done == 0) {
+        b->t_submit = now_seconds();
+    }
+
+    if (p->uring) {
+        lock_uring_queue(&p->u, b->op, (b->op == LOCK_IO_READ) ? p->in : p->out, &b->iov, off + b->done, (uint64_t)i);
+    }
+    else {
+        pthread_mutex_lock(&p->lock);
+        lock_fifo_push(&p->io_todo, i);
+        pthread_cond_signal(&p->io_cv);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+static void *lock_pipe_worker(void *arg) {
+    struct lock_pipe *p = arg;
+    double waited = 0, queued = 0;
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        double t0 = now_seconds();
+        while (p->filled.len == 0 && !p->quit) {
+            pthread_cond_wait(&p->filled_cv, &p->lock);
+        }
+        waited += now_seconds() - t0;
+        if (p->quit) {
+            break;
+        }
+        int i = lock_fifo_pop(&p->filled);
+        struct lock_pipe_buf *b = &p->buf[i];
+        pthread_mutex_unlock(&p->lock);
+
+        queued += t0 - b->t_queued > 0 ? t0 - b->t_queued : 0;
+        size_t k, code = p->rec_bytes / 2;
+        int bcd = (p->h->flags & LOCK_CORPUS_BCD) != 0;
+        for (k = 0; k < b->n; k++) {
+            const uint8_t *S = b->in + k * p->rec_bytes;
+            b->out[k] = (uint32_t)(bcd ? unlocker_bcd(2 * code, S, S + code) : lock_cost(code, (const char *)S, (const char *)S + code));
+        }
+
+        pthread_mutex_lock(&p->lock);
+        lock_fifo_push(&p->scored, i);
+        lock_pipe_kick(p);
+    }
+    p->st->worker_wait_s += waited;
+    p->st->queue_wait_s += queued;
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+// Scores IN (a fixed-width corpus) into OUT. engine is "uring", "threads" or NULL (try
+// io_uring first). chunk is records per buffer, depth the number of buffers in flight.
+// Returns 0 on failure.
+int lock_pipeline(const char *in_path, const char *out_path, const char *engine, int workers, size_t chunk, int depth, struct lock_pipe_stats *st) {
+    struct lock_corpus_header h;
+    struct lock_results_header rh;
+    struct lock_pipe p;
+    pthread_t wt[LOCK_MAX_THREADS], iot[2];
+    int nw = 0, nio = 0, i, ok = 1;
+    size_t next = 0, written = 0;
+    int idle, inflight = 0;
+    double t0 = now_seconds();
+
+    memset(&p, 0, sizeof(p));
+    memset(st, 0, sizeof(*st));
+    p.st = st;
+    p.in = open(in_path, O_RDONLY);
+    if (p.in < 0) {
+        perror(in_path);
+        return 0;
+    }
+    if (pread(p.in, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || memcmp(h.magic, "LOCKCORP", 8) != 0 ||
+        h.version != LOCK_CORPUS_VERSION || (h.flags & LOCK_CORPUS_VARIABLE)) {
+        fprintf(stderr, "%s is not a fixed-width corpus\n", in_path);
+        close(p.in);
+        return 0;
+    }
+    posix_fadvise(p.in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    p.h = &h;
+    p.rec_bytes = 2 * lock_corpus_code_bytes(h.flags, h.width);
+    p.out = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (p.out < 0) {
+        perror(out_path);
+        close(p.in);
+        return 0;
+    }
+    p.efd = eventfd(0, 0);
+    if (p.efd < 0) {
+        perror("eventfd");
+        close(p.out);
+        close(p.in);
+        return 0;
+    }
+    memset(&rh, 0, sizeof(rh));
+    memcpy(rh.magic, "LOCKCOST", 8);
+    rh.version = 1;
+    rh.count = h.count;
+    ok = pwrite(p.out, &rh, sizeof(rh), 0) == (ssize_t)sizeof(rh) &&
+         ftruncate(p.out, (off_t)(sizeof(rh) + h.count * sizeof(uint32_t))) == 0;
+
+    if (workers <= 0) {
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    workers = (workers < 1) ? 1 : (workers > LOCK_MAX_THREADS) ? LOCK_MAX_THREADS : workers;
+    depth = (depth < 1) ? 4 : depth;
+    chunk = (chunk == 0) ? 65536 : chunk;
+
+    //Enough buffers for depth reads in flight plus one being scored per worker
+    p.nbufs = depth + workers;
+    p.buf = calloc((size_t)p.nbufs, sizeof(*p.buf));
+    p.io_res = calloc((size_t)p.nbufs, sizeof(int));
+    p.filled.item = malloc(4 * (size_t)p.nbufs * sizeof(int));
+    p.filled.cap = p.scored.cap = p.io_todo.cap = p.io_done.cap = p.nbufs;
+    if (p.buf == NULL || p.io_res == NULL || p.filled.item == NULL) {
+        ok = 0;
+    }
+    else {
+        p.scored.item = p.filled.item + p.nbufs;
+        p.io_todo.item = p.filled.item + 2 * p.nbufs;
+        p.io_done.item = p.filled.item + 3 * p.nbufs;
+    }
+    for (i = 0; ok && i < p.nbufs; i++) {
+        p.buf[i].in = malloc(chunk * p.rec_bytes);
+        p.buf[i].out = malloc(chunk * sizeof(uint32_t));
+        ok = p.buf[i].in != NULL && p.buf[i].out != NULL;
+    }
+
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.filled_cv, NULL);
+    pthread_cond_init(&p.io_cv, NULL);
+
+    if (ok && (engine == NULL || strcmp(engine, "uring") == 0)) {
+        p.uring = lock_uring_init(&p.u, 2 * (unsigned)p.nbufs, p.efd);
+        if (!p.uring && engine != NULL) {
+            fprintf(stderr, "io_uring is not available\n");
+            ok = 0;
+        }
+    }
+    st->engine = p.uring ? "uring" : "threads";
+    for (nio = 0; ok && !p.uring && nio < 2; nio++) {
+        if (pthread_create(&iot[nio], NULL, lock_pipe_io_thread, &p) != 0) {
+            ok = 0;
+            break;
+        }
+    }
+    for (nw = 0; ok && nw < workers; nw++) {
+        if (pthread_create(&wt[nw], NULL, lock_pipe_worker, &p) != 0) {
+            ok = 0;
+            break;
+        }
+    }
+    st->workers = nw;
+
+    //Every buffer starts free
+    idle = p.nbufs;
+    int *free_list = malloc((size_t)p.nbufs * sizeof(int));
+    if (free_list == NULL) {
+        ok = 0;
+    }
+    for (i = 0; ok && i < p.nbufs; i++) {
+        free_list[i] = i;
+    }
+
+    while (ok && written < h.count) {
+        uint64_t tag, cnt;
+        int res;
+
+        //Fill free buffers with reads
+        while (idle > 0 && next < h.count) {
+            int k = free_list[--idle];
+            struct lock_pipe_buf *b = &p.buf[k];
+            b->first = next;
+            b->n = (h.count - next < chunk) ? h.count - next : chunk;
+            b->op = LOCK_IO_READ;
+            b->done = 0;
+            next += b->n;
+            lock_pipe_submit(&p, k);
+            inflight++;
+        }
+        if (p.uring && !lock_uring_submit(&p.u)) {
+            ok = 0;
+            break;
+        }
+
+        double tw = now_seconds();
+        while (read(p.efd, &cnt, sizeof(cnt)) < 0) {
+            if (errno != EINTR) {
+                ok = 0;
+                break;
+            }
+        }
+        st->driver_wait_s += now_seconds() - tw;
+
+        //I/O completions
+        for (;;) {
+            if (p.uring) {
+                if (!lock_uring_reap(&p.u, &tag, &res)) {
+                    break;
+                }
+            }
+            else {
+                pthread_mutex_lock(&p.lock);
+                if (p.io_done.len == 0) {
+                    pthread_mutex_unlock(&p.lock);
+                    break;
+                }
+                tag = (uint64_t)lock_fifo_pop(&p.io_done);
+                res = p.io_res[tag];
+                pthread_mutex_unlock(&p.lock);
+            }
+
+            struct lock_pipe_buf *b = &p.buf[tag];
+            inflight--;
+            size_t len = (b->op == LOCK_IO_READ) ? b->n * p.rec_bytes : b->n * sizeof(uint32_t);
+            if (res <= 0) {
+                fprintf(stderr, "%s failed: %s\n", b->op == LOCK_IO_READ ? "read" : "write", res < 0 ? strerror(-res) : "unexpected end of file");
+                ok = 0;
+                break;
+            }
+            b->done += (size_t)res;
+            if (b->done < len) {
+                //Short transfer, go again for the rest
+                lock_pipe_submit(&p, (int)tag);
+                inflight++;
+                continue;
+            }
+
+            if (b->op == LOCK_IO_READ) {
+                st->read_s += now_seconds() - b->t_submit;
+                st->bytes_read += len;
+                b->t_queued = now_seconds();
+                pthread_mutex_lock(&p.lock);
+                lock_fifo_push(&p.filled, (int)tag);
+                pthread_cond_signal(&p.filled_cv);
+                pthread_mutex_unlock(&p.lock);
+            }
+            else {
+                st->write_s += now_seconds() - b->t_submit;
+                written += b->n;
+                free_list[idle++] = (int)tag;
+            }
+        }
+
+        //Scored buffers go out as writes
+        for (;;) {
+            pthread_mutex_lock(&p.lock);
+            if (p.scored.len == 0) {
+                pthread_mutex_unlock(&p.lock);
+                break;
+            }
+            int k = lock_fifo_pop(&p.scored);
+            pthread_mutex_unlock(&p.lock);
+
+            p.buf[k].op = LOCK_IO_WRITE;
+            p.buf[k].done = 0;
+            lock_pipe_submit(&p, k);
+            inflight++;
+        }
+    }
+
+    //After a failure the kernel may still own some buffers; wait for them to come back
+    while (p.uring && inflight > 0) {
+        uint64_t tag, cnt;
+        int res;
+
+        lock_uring_submit(&p.u);
+        while (lock_uring_reap(&p.u, &tag, &res)) {
+            inflight--;
+        }
+        if (inflight > 0 && read(p.efd, &cnt, sizeof(cnt)) < 0 && errno != EINTR) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&p.lock);
+    p.quit = 1;
+    pthread_cond_broadcast(&p.filled_cv);
+    pthread_cond_broadcast(&p.io_cv);
+    pthread_mutex_unlock(&p.lock);
+    for (i = 0; i < nw; i++) {
+        pthread_join(wt[i], NULL);
+    }
+    for (i = 0; i < nio; i++) {
+        pthread_join(iot[i], NULL);
+    }
+    if (p.uring) {
+        lock_uring_exit(&p.u);
+    }
+
+    ok = ok && fsync(p.out) == 0;
+    st->pairs = written;
+    st->seconds = now_seconds() - t0;
+
+    for (i = 0; p.buf != NULL && i < p.nbufs; i++) {
+        free(p.buf[i].in);
+        free(p.buf[i].out);
+    }
+    free(free_list);
+    free(p.buf);
+    free(p.io_res);
+    free(p.filled.item);
+    pthread_mutex_destroy(&p.lock);
+    pthread_cond_destroy(&p.filled_cv);
+    pthread_cond_destroy(&p.io_cv);
+    close(p.efd);
+    close(p.in);
+    close(p.out);
+
+    return ok;
+}
+
+// Query server for other processes on the same host. Clients connect over a Unix socket
+// or loopback TCP and may pipeline any number of queries. One epoll loop reads whatever is
+// ready on every connection, queues the integer queries, and scores the whole wake's worth
+// as a micro-batch with the batch kernels (grouped by width) before any reply is written.
+// Replies come back in request order per connection. Byte order is native on both ends,
+// since both ends are on the same machine.
+//
+//   query: struct lock_query, then two uint64 codes (LOCK_QUERY_CODES, digits <= 20) or
+//          digits bytes of S followed by digits bytes of E (LOCK_QUERY_TEXT)
+//   reply: struct lock_reply; cost is -1 for a query that can't be scored
+enum { LOCK_QUERY_CODES, LOCK_QUERY_TEXT };
+
+#define LOCK_QUERY_MAX_DIGITS 4096
+#define LOCK_SERVE_BATCH 4096
+#define LOCK_SERVE_READ (64 << 10)
+#define LOCK_SERVE_BACKLOG (1 << 20)    //Stop reading a client with this much unsent
+#define LOCK_LOAD_MAX_DEPTH 65536       //Well under the backlog, so a client can't deadlock
+
+struct lock_query {
+    uint32_t id;
+    uint16_t kind;
+    uint16_t digits;
+};
+
+struct lock_reply {
+    uint32_t id;
+    int32_t cost;
+};
+
+// "unix:PATH", "tcp:PORT" or just PORT. TCP is always 127.0.0.1.
+static int lock_addr_parse(const char *addr, struct sockaddr_storage *sa, socklen_t *len) {
+    memset(sa, 0, sizeof(*sa));
+    if (strncmp(addr, "unix:", 5) == 0) {
+        struct sockaddr_un *un = (struct sockaddr_un *)sa;
+
+        if (strlen(addr + 5) >= sizeof(un->sun_path)) {
+            return 0;
+        }
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, addr + 5);
+        *len = sizeof(*un);
+    }
+    else {
+        struct sockaddr_in *in = (struct sockaddr_in *)sa;
+        int port = atoi(strncmp(addr, "tcp:", 4) == 0 ? addr + 4 : addr);
+
+        if (port <= 0 || port > 65535) {
+            return 0;
+        }
+        in->sin_family = AF_INET;
+        in->sin_port = htons((uint16_t)port);
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        *len = sizeof(*in);
+    }
+    return 1;
+}
+
+struct lock_conn {
+    int fd;
+    int dead;
+    int eof;                //the client has shut its side, so close once out is sent
+    uint32_t events;        //what epoll is watching for
+    char *in;
+    size_t in_len;
+    char *out;
+    size_t out_pos, out_len, out_cap;
+};
+
+struct lock_serve_stats {
+    size_t connections;
+    size_t queries;
+    size_t text_queries;
+    size_t batches;
+    size_t largest_batch;
+    double seconds;
+};
+
+struct lock_serve {
+    int ep;
+    struct lock_serve_stats *st;
+    //Pending integer queries; their replies are already reserved in conn[k]->out at slot[k]
+    size_t count;
+    uint64_t S[LOCK_SERVE_BATCH], E[LOCK_SERVE_BATCH];
+    uint8_t digits[LOCK_SERVE_BATCH];
+    struct lock_conn *conn[LOCK_SERVE_BATCH];
+    size_t slot[LOCK_SERVE_BATCH];
+    //Scratch for grouping by width
+    uint64_t gS[LOCK_SERVE_BATCH], gE[LOCK_SERVE_BATCH];
+    int gP[LOCK_SERVE_BATCH];
+    uint16_t order[LOCK_SERVE_BATCH];
+};
+
+static volatile sig_atomic_t lock_serve_stop;
+
+static void lock_serve_signal(int sig) {
+    (void)sig;
+    lock_serve_stop = 1;
+}
+
+// Offset of a fresh reply in c->out, or -1 when out of memory
+static ptrdiff_t lock_conn_reserve(struct lock_conn *c, uint32_t id, int32_t cost) {
+    struct lock_reply r;
+
+    //No compacting here: queued batch entries hold offsets into c->out
+    if (c->out_len + sizeof(r) > c->out_cap) {
+        size_t cap = c->out_cap ? 2 * c->out_cap : 4096;
+        char *p = realloc(c->out, cap);
+
+        if (p == NULL) {
+            return -1;
+        }
+        c->out = p;
+        c->out_cap = cap;
+    }
+
+    r.id = id;
+    r.cost = cost;
+    memcpy(c->out + c->out_len, &r, sizeof(r));
+    c->out_len += sizeof(r);
+
+    return (ptrdiff_t)(c->out_len - sizeof(r));
+}
+
+// Scores every queued integer query and fills in the reserved replies
+static void lock_serve_flush(struct lock_serve *sv) {
+    size_t start[22], k;
+    int n;
+
+    if (sv->count == 0) {
+        return;
+    }
+
+    //Counting sort by width, so each width is one call into the batch kernels
+    memset(start, 0, sizeof(start));
+    for (k = 0; k < sv->count; k++) {
+        start[sv->digits[k] + 1]++;
+    }
+    for (n = 1; n < 22; n++) {
+        start[n] += start[n - 1];
+    }
+    for (k = 0; k < sv->count; k++) {
+        size_t g = start[sv->digits[k]]++;
+        sv->order[g] = (uint16_t)k;
+        sv->gS[g] = sv->S[k];
+        sv->gE[g] = sv->E[k];
+    }
+    for (n = 0, k = 0; n <= 20; n++) {
+        //start[n] is now the end of width n
+        if (start[n] > k) {
+            unlocker_batch_u64(n, sv->gS + k, sv->gE + k, sv->gP + k, start[n] - k);
+            k = start[n];
+        }
+    }
+
+    for (k = 0; k < sv->count; k++) {
+        size_t j = sv->order[k];
+        int32_t cost = sv->gP[k];
+
+        memcpy(sv->conn[j]->out + sv->slot[j] + offsetof(struct lock_reply, cost), &cost, sizeof(cost));
+    }
+
+    sv->st->batches++;
+    if (sv->count > sv->st->largest_batch) {
+        sv->st->largest_batch = sv->count;
+    }
+    sv->count = 0;
+}
+
+// Turns every complete query in c->in into a reply or a queued batch entry
+static void lock_conn_parse(struct lock_serve *sv, struct lock_conn *c) {
+    size_t pos = 0;
+
+    while (c->in_len - pos >= sizeof(struct lock_query)) {
+        struct lock_query q;
+        const char *body = c->in + pos + sizeof(q);
+        size_t size;
+        ptrdiff_t slot;
+
+        memcpy(&q, c->in + pos, sizeof(q));
+        if (q.kind > LOCK_QUERY_TEXT || q.digits > LOCK_QUERY_MAX_DIGITS) {
+            //Can't find the next query after this one
+            c->dead = 1;
+            return;
+        }
+        size = (q.kind == LOCK_QUERY_CODES) ? 2 * sizeof(uint64_t) : 2 * (size_t)q.digits;
+        if (c->in_len - pos < sizeof(q) + size) {
+            break;
+        }
+        pos += sizeof(q) + size;
+        sv->st->queries++;
+
+        if (q.kind == LOCK_QUERY_TEXT) {
+            int32_t cost = -1;
+
+            if (lock_scan_digits(body, body + size) == body + size) {
+                cost = (int32_t)lock_cost(q.digits, body, body + q.digits);
+            }
+            sv->st->text_queries++;
+            if (lock_conn_reserve(c, q.id, cost) < 0) {
+                c->dead = 1;
+                return;
+            }
+        }
+        else {
+            uint64_t S, E;
+
+            memcpy(&S, body, sizeof(S));
+            memcpy(&E, body + sizeof(S), sizeof(E));
+            if (q.digits > 20 || (q.digits < 20 && (S >= ipow(10, q.digits) || E >= ipow(10, q.digits)))) {
+                slot = lock_conn_reserve(c, q.id, -1);
+            }
+            else {
+                if (sv->count == LOCK_SERVE_BATCH) {
+                    lock_serve_flush(sv);
+                }
+                slot = lock_conn_reserve(c, q.id, 0);
+                sv->S[sv->count] = S;
+                sv->E[sv->count] = E;
+                sv->digits[sv->count] = (uint8_t)q.digits;
+                sv->conn[sv->count] = c;
+                sv->slot[sv->count] = (size_t)slot;
+                sv->count += (slot >= 0);
+            }
+            if (slot < 0) {
+                c->dead = 1;
+                return;
+            }
+        }
+    }
+
+    memmove(c->in, c->in + pos, c->in_len - pos);
+    c->in_len -= pos;
+}
+
+// Sends what it can without blocking, then sets what epoll should watch for
+static void lock_conn_write(struct lock_serve *sv, struct lock_conn *c) {
+    uint32_t want;
+
+    while (!c->dead && c->out_pos < c->out_len) {
+        ssize_t w = send(c->fd, c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                c->dead = 1;
+            }
+            break;
+        }
+        c->out_pos += (size_t)w;
+    }
+    //The batch is empty now, so replies can move
+    if (c->out_pos == c->out_len) {
+        c->out_pos = c->out_len = 0;
+    }
+    else if (c->out_pos > c->out_cap / 2) {
+        memmove(c->out, c->out + c->out_pos, c->out_len - c->out_pos);
+        c->out_len -= c->out_pos;
+        c->out_pos = 0;
+    }
+    if (c->eof && c->out_pos == c->out_len) {
+        c->dead = 1;
+    }
+    if (c->dead) {
+        return;
+    }
+
+    //Nothing more to read after EOF, and watching for it would wake us on every pass
+    want = (!c->eof && c->out_len - c->out_pos < LOCK_SERVE_BACKLOG) ? EPOLLIN : 0;
+    want |= (c->out_pos < c->out_len) ? EPOLLOUT : 0;
+    if (want != c->events) {
+        struct epoll_event ev;
+
+        ev.events = want;
+        ev.data.ptr = c;
+        epoll_ctl(sv->ep, EPOLL_CTL_MOD, c->fd, &ev);
+        c->events = want;
+    }
+}
+
+static void lock_conn_close(struct lock_serve *sv, struct lock_conn *c) {
+    epoll_ctl(sv->ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+// Serves ADDR until SIGINT or SIGTERM. Returns 0 if the socket can't be set up.
+int lock_serve(const char *addr, struct lock_serve_stats *st) {
+    struct sockaddr_storage sa;
+    socklen_t salen;
+    struct epoll_event ev, events[256];
+    struct sigaction act;
+    struct lock_serve *sv;
+    int lfd, one = 1, n, i;
+    double t0;
+
+    memset(st, 0, sizeof(*st));
+    if (!lock_addr_parse(addr, &sa, &salen)) {
+        fprintf(stderr, "bad address %s (unix:PATH, tcp:PORT or PORT)\n", addr);
+        return 0;
+    }
+    if ((sv = calloc(1, sizeof(*sv))) == NULL) {
+        return 0;
+    }
+    sv->st = st;
+
+    if (sa.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&sa)->sun_path);
+    }
+    lfd = socket(sa.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        perror("socket");
+        free(sv);
+        return 0;
+    }
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&sa, salen) < 0 || listen(lfd, SOMAXCONN) < 0) {
+        perror(addr);
+        close(lfd);
+        free(sv);
+        return 0;
+    }
+
+    sv->ep = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;     //NULL marks the listening socket
+    epoll_ctl(sv->ep, EPOLL_CTL_ADD, lfd, &ev);
+
+    //No SA_RESTART, so a signal gets epoll_wait out with EINTR
+    memset(&act, 0, sizeof(act));
+    act.sa_handler = lock_serve_signal;
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+
+    t0 = now_seconds();
+    while (!lock_serve_stop) {
+        n = epoll_wait(sv->ep, events, 256, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        //Read and parse everything that's ready; integer queries pile up in the batch
+        for (i = 0; i < n; i++) {
+            struct lock_conn *c = events[i].data.ptr;
+
+            if (c == NULL) {
+                int fd;
+
+                while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    if ((c = calloc(1, sizeof(*c))) == NULL || (c->in = malloc(LOCK_SERVE_READ)) == NULL) {
+                        free(c);
+                        close(fd);
+                        continue;
+                    }
+                    if (sa.ss_family == AF_INET) {
+                        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    }
+                    c->fd = fd;
+                    c->events = EPOLLIN;
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = c;
+                    epoll_ctl(sv->ep, EPOLL_CTL_ADD, fd, &ev);
+                    st->connections++;
+                }
+                continue;
+            }
+
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                ssize_t r = read(c->fd, c->in + c->in_len, LOCK_SERVE_READ - c->in_len);
+                if (r > 0) {
+                    c->in_len += (size_t)r;
+                    lock_conn_parse(sv, c);
+                }
+                else if (r == 0) {
+                    //A half-close still gets the replies to what it already sent
+                    c->eof = 1;
+                }
+                else if (errno != EAGAIN && errno != EINTR) {
+                    c->dead = 1;
+                }
+            }
+        }
+
+        lock_serve_flush(sv);
+
+        //Every connection in this wake either has new replies or was waiting to send
+        for (i = 0; i < n; i++) {
+            struct lock_conn *c = events[i].data.ptr;
+
+            if (c != NULL) {
+                lock_conn_write(sv, c);
+            }
+        }
+        for (i = 0; i < n; i++) {
+            struct lock_conn *c = events[i].data.ptr;
+
+            if (c != NULL && c->dead) {
+                lock_conn_close(sv, c);
+            }
+        }
+    }
+    st->seconds = now_seconds() - t0;
+
+    //Open connections are left for exit() to clean up
+    close(sv->ep);
+    close(lfd);
+    if (sa.ss_family == AF_UNIX) {
+        unlink(((struct sockaddr_un *)&sa)->sun_path);
+    }
+    free(sv);
+
+    return 1;
+}
+
+// Load generator: every client thread owns one connection and keeps depth queries in
+// flight on it, sending more as soon as replies arrive. Latency is time from a query
+// being handed to send() until its reply is read.
+struct lock_load_client {
+    const struct sockaddr_storage *sa;
+    socklen_t salen;
+    const struct lock_workload *w;
+    const uint64_t *S, *E;      //Integer codes, NULL to send text queries
+    const int32_t *expect;
+    size_t first, count;
+    int depth;
+    double *lat;                //Send time, then latency, per query
+    size_t wrong;
+    int ok;
+};
+
+static void *lock_load_thread(void *arg) {
+    struct lock_load_client *cl = arg;
+    size_t qsize = sizeof(struct lock_query) + (cl->S != NULL ? 2 * sizeof(uint64_t) : 2 * cl->w->width);
+    size_t sent = 0, done = 0, have = 0;
+    char *out = malloc(qsize * (size_t)cl->depth);
+    char in[16 << 10];
+    int fd, one = 1;
+
+    cl->ok = 0;
+    fd = socket(cl->sa->ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (out == NULL || fd < 0 || connect(fd, (const struct sockaddr *)cl->sa, cl->salen) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(out);
+        return NULL;
+    }
+    if (cl->sa->ss_family == AF_INET) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    while (done < cl->count) {
+        char *p = out;
+        size_t k;
+        ssize_t r;
+
+        //Top the window back up in one write
+        while (sent < cl->count && sent - done < (size_t)cl->depth) {
+            struct lock_query q;
+            size_t g = cl->first + sent;
+
+            q.id = (uint32_t)g;
+            q.kind = (cl->S != NULL) ? LOCK_QUERY_CODES : LOCK_QUERY_TEXT;
+            q.digits = (uint16_t)cl->w->width;
+            memcpy(p, &q, sizeof(q));
+            if (cl->S != NULL) {
+                memcpy(p + sizeof(q), &cl->S[g], sizeof(uint64_t));
+                memcpy(p + sizeof(q) + sizeof(uint64_t), &cl->E[g], sizeof(uint64_t));
+            }
+            else {
+                memcpy(p + sizeof(q), cl->w->S + g * cl->w->width, cl->w->width);
+                memcpy(p + sizeof(q) + cl->w->width, cl->w->E + g * cl->w->width, cl->w->width);
+            }
+            p += qsize;
+            cl->lat[sent++] = now_seconds();
+        }
+        if (p > out && !lock_write_all(fd, out, (size_t)(p - out))) {
+            break;
+        }
+
+        r = read(fd, in + have, sizeof(in) - have);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        have += (size_t)r;
+        for (k = 0; k + sizeof(struct lock_reply) <= have; k += sizeof(struct lock_reply)) {
+            struct lock_reply rep;
+            size_t j;
+
+            memcpy(&rep, in + k, sizeof(rep));
+            j = rep.id - cl->first;
+            if (rep.id < cl->first || j >= sent) {
+                goto fail;
+            }
+            cl->lat[j] = now_seconds() - cl->lat[j];
+            cl->wrong += (rep.cost != cl->expect[rep.id]);
+            done++;
+        }
+        memmove(in, in + k, have - k);
+        have -= k;
+    }
+    cl->ok = (done == cl->count);
+
+fail:
+    close(fd);
+    free(out);
+    return NULL;
+}
+
+static int lock_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+struct lock_load_stats {
+    size_t queries;
+    size_t wrong;
+    double seconds;
+    double p50, p99, p999, max;
+};
+
+// Runs count queries from w against ADDR over clients connections. Returns 0 on failure.
+int lock_load(const char *addr, const struct lock_workload *w, int clients, int depth, struct lock_load_stats *st) {
+    static struct lock_load_client cl[LOCK_MAX_THREADS];
+    pthread_t tid[LOCK_MAX_THREADS];
+    struct sockaddr_storage sa;
+    socklen_t salen;
+    uint64_t *S = NULL, *E = NULL;
+    int32_t *expect;
+    double *lat, t0;
+    size_t k;
+    int i, started, ok = 1;
+
+    memset(st, 0, sizeof(*st));
+    if (!lock_addr_parse(addr, &sa, &salen)) {
+        fprintf(stderr, "bad address %s (unix:PATH, tcp:PORT or PORT)\n", addr);
+        return 0;
+    }
+    clients = clients < 1 ? 1 : clients > LOCK_MAX_THREADS ? LOCK_MAX_THREADS : clients;
+    depth = depth < 1 ? 1 : depth > LOCK_LOAD_MAX_DEPTH ? LOCK_LOAD_MAX_DEPTH : depth;
+    if (w->width > LOCK_QUERY_MAX_DIGITS) {
+        fprintf(stderr, "queries are limited to %d digits\n", LOCK_QUERY_MAX_DIGITS);
+        return 0;
+    }
+
+    expect = malloc(w->count * sizeof(int32_t));
+    lat = malloc(w->count * sizeof(double));
+    if (w->width <= 19) {
+        S = malloc(w->count * sizeof(uint64_t));
+        E = malloc(w->count * sizeof(uint64_t));
+    }
+    if (expect == NULL || lat == NULL || (w->width <= 19 && (S == NULL || E == NULL))) {
+        fprintf(stderr, "out of memory\n");
+        free(expect);
+        free(lat);
+        free(S);
+        free(E);
+        return 0;
+    }
+    if (S != NULL) {
+        lock_workload_u64(w, S, E);
+    }
+    for (k = 0; k < w->count; k++) {
+        expect[k] = (int32_t)lock_cost(w->width, w->S + k * w->width, w->E + k * w->width);
+    }
+
+    t0 = now_seconds();
+    for (i = 0; i < clients; i++) {
+        cl[i].sa = &sa;
+        cl[i].salen = salen;
+        cl[i].w = w;
+        cl[i].S = S;
+        cl[i].E = E;
+        cl[i].expect = expect;
+        cl[i].first = w->count * i / clients;
+        cl[i].count = w->count * (i + 1) / clients - cl[i].first;
+        cl[i].depth = depth;
+        cl[i].lat = lat + cl[i].first;
+        cl[i].wrong = 0;
+        if (pthread_create(&tid[i], NULL, lock_load_thread, &cl[i]) != 0) {
+            fprintf(stderr, "can't start client %d\n", i);
+            ok = 0;
+            break;
+        }
+    }
+    //Only the clients that started have a thread and a result
+    started = i;
+    for (i = 0; i < started; i++) {
+        pthread_join(tid[i], NULL);
+        ok &= cl[i].ok;
+        st->wrong += cl[i].wrong;
+    }
+    st->seconds = now_seconds() - t0;
+
+    if (ok && w->count > 0) {
+        qsort(lat, w->count, sizeof(double), lock_cmp_double);
+        st->queries = w->count;
+        st->p50 = lat[(size_t)(0.5 * (w->count - 1))];
+        st->p99 = lat[(size_t)(0.99 * (w->count - 1))];
+        st->p999 = lat[(size_t)(0.999 * (w->count - 1))];
+        st->max = lat[w->count - 1];
+    }
+
+    free(expect);
+    free(lat);
+    free(S);
+    free(E);
+
+    return ok;
+}
+
+// Hardware counters around benchmark regions, through perf_event_open. Every counter is
+// opened on its own (user space only, inherited by threads created afterwards, so the pool
+// is covered if it's made later) and left running; a region is the difference of two
+// reads, scaled by enabled/running time in case the PMU had to multiplex. Counters the
+// kernel won't give us (no PMU in a VM, perf_event_paranoid, seccomp) are just missing.
+enum { LOCK_PERF_CYCLES, LOCK_PERF_INSTRUCTIONS, LOCK_PERF_BRANCH_MISSES, LOCK_PERF_L1D_MISSES, LOCK_PERF_LLC_MISSES, LOCK_PERF_EVENTS };
+
+static const char *const lock_perf_names[LOCK_PERF_EVENTS] = { "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses" };
+
+struct lock_perf {
+    int fd[LOCK_PERF_EVENTS];
+    int open;               //how many counters are live
+    int err;                //errno of the first one that wasn't
+};
+
+// value, time enabled, time running
+struct lock_perf_read {
+    uint64_t v[LOCK_PERF_EVENTS][3];
+};
+
+// Returns the number of counters opened
+int lock_perf_open(struct lock_perf *p) {
+    static const struct { uint32_t type; uint64_t config; } ev[LOCK_PERF_EVENTS] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+        { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16 },
+    };
+    int i;
+
+    p->open = 0;
+    p->err = 0;
+    for (i = 0; i < LOCK_PERF_EVENTS; i++) {
+        struct perf_event_attr a;
+
+        memset(&a, 0, sizeof(a));
+        a.size = sizeof(a);
+        a.type = ev[i].type;
+        a.config = ev[i].config;
+        a.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        a.exclude_kernel = 1;
+        a.exclude_hv = 1;
+        a.inherit = 1;
+        p->fd[i] = (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+        if (p->fd[i] >= 0) {
+            p->open++;
+        }
+        else if (p->err == 0) {
+            p->err = errno;
+        }
+    }
+
+    return p->open;
+}
+
+void lock_perf_close(struct lock_perf *p) {
+    int i;
+
+    for (i = 0; i < LOCK_PERF_EVENTS; i++) {
+        if (p->fd[i] >= 0) {
+            close(p->fd[i]);
+            p->fd[i] = -1;
+        }
+    }
+    p->open = 0;
+}
+
+void lock_perf_sample(const struct lock_perf *p, struct lock_perf_read *r) {
+    int i;
+
+    memset(r, 0, sizeof(*r));
+    for (i = 0; i < LOCK_PERF_EVENTS; i++) {
+        if (p->fd[i] >= 0 && read(p->fd[i], r->v[i], sizeof(r->v[i])) != (ssize_t)sizeof(r->v[i])) {
+            memset(r->v[i], 0, sizeof(r->v[i]));
+        }
+    }
+}
+
+// Events between two samples; -1 where a counter is missing or never got scheduled
+void lock_perf_delta(const struct lock_perf *p, const struct lock_perf_read *a, const struct lock_perf_read *b, double *out) {
+    int i;
+
+    for (i = 0; i < LOCK_PERF_EVENTS; i++) {
+        double run = (double)(b->v[i][2] - a->v[i][2]);
+
+        out[i] = -1;
+        if (p->fd[i] >= 0 && run > 0) {
+            out[i] = (double)(b->v[i][0] - a->v[i][0]) * (double)(b->v[i][1] - a->v[i][1]) / run;
+        }
+    }
+}
+
+// Single-call latency. Calls are bracketed by lfence; rdtsc; lfence and rdtscp; lfence, so
+// nothing from the call leaks outside the timed window and nothing else leaks in. Samples
+// are in TSC ticks, converted to ns with a frequency measured against CLOCK_MONOTONIC_RAW.
+// The histogram is log-linear like HdrHistogram: 2^LOCK_HIST_SUB linear sub-buckets per
+// power of two, so any value is recorded to within 1% and the whole range fits in 58 KB.
+#define LOCK_HIST_SUB 7
+#define LOCK_HIST_BUCKETS ((64 - LOCK_HIST_SUB + 1) << LOCK_HIST_SUB)
+
+struct lock_hist {
+    uint64_t count;
+    uint64_t min, max;
+    double sum;
+    uint64_t bucket[LOCK_HIST_BUCKETS];
+};
+
+static inline uint64_t lock_tsc_start(void) {
+    uint64_t t;
+
+    _mm_lfence();
+    t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+static inline uint64_t lock_tsc_stop(void) {
+    unsigned int aux;
+    uint64_t t = __rdtscp(&aux);
+
+    _mm_lfence();
+    return t;
+}
+
+// Whether the TSC ticks at a constant rate through frequency and idle states
+int lock_tsc_invariant(void) {
+    unsigned int a, b, c, d;
+
+    return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+}
+
+// TSC ticks per nanosecond, from a ~50 ms run against the raw monotonic clock
+double lock_tsc_calibrate(void) {
+    struct timespec a, b;
+    uint64_t t0, t1;
+    double ns;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &a);
+    t0 = lock_tsc_start();
+    do {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &b);
+        ns = (b.tv_sec - a.tv_sec) * 1e9 + (b.tv_nsec - a.tv_nsec);
+    } while (ns < 5e7);
+    t1 = lock_tsc_stop();
+
+    return (t1 - t0) / ns;
+}
+
+void lock_hist_reset(struct lock_hist *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+// Values below 2^(SUB+1) get a bucket each; above that, the top SUB+1 bits pick it
+static inline unsigned int lock_hist_index(uint64_t v) {
+    unsigned int shift;
+
+    if (v < (2u << LOCK_HIST_SUB)) {
+        return (unsigned int)v;
+    }
+    shift = 63 - __builtin_clzll(v) - LOCK_HIST_SUB;
+    return (shift << LOCK_HIST_SUB) + (unsigned int)(v >> shift);
+}
+
+static inline void lock_hist_add(struct lock_hist *h, uint64_t v) {
+    h->bucket[lock_hist_index(v)]++;
+    h->count++;
+    h->sum += (double)v;
+    h->min = (v < h->min) ? v : h->min;
+    h->max = (v > h->max) ? v : h->max;
+}
+
+// Highest value that lands in the same bucket as the q-quantile (HdrHistogram reports the
+// same), never above the largest value recorded
+uint64_t lock_hist_quantile(const struct lock_hist *h, double q) {
+    uint64_t want = (uint64_t)(q * h->count + 0.5), seen = 0, top;
+    unsigned int i, shift;
+
+    if (h->count == 0) {
+        return 0;
+    }
+    want = (want < 1) ? 1 : (want > h->count) ? h->count : want;
+    for (i = 0; i < LOCK_HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= want) {
+            break;
+        }
+    }
+    if (i < (2u << LOCK_HIST_SUB)) {
+        top = i;
+    }
+    else {
+        shift = (i >> LOCK_HIST_SUB) - 1;
+        top = (((uint64_t)(i & ((1u << LOCK_HIST_SUB) - 1)) + (1u << LOCK_HIST_SUB)) << shift) + ((1ull << shift) - 1);
+    }
+
+    return (top < h->max) ? top : h->max;
+}
+
+// Benchmark suite. Every case does one "rep" of work per call and returns a checksum that
+// goes into lock_sink, so nothing can be optimized away. The rep count per trial doubles
+// until a trial takes at least min_time (which also warms caches, branch predictors and
+// the pool), then the trials are timed. Results go to stdout as JSON.
+volatile long long lock_sink;
+
+struct lock_opts {
+    int trials;
+    double min_time;
+    size_t max_digits;
+    const char *backend;    //NULL = sweep every supported backend
+    struct lock_pool_config pool;
+    uint64_t seed;
+    int dist;
+    const char *cache;      //directory for generated workloads, NULL = don't cache
+    size_t count;
+    size_t width;
+    uint32_t corpus_flags;
+    int stats;
+    int depth;
+    const char *engine;     //pipeline I/O engine, NULL = io_uring if available
+    int k;                  //nearest codes per query
+    int budget;             //highest cost a within-budget query accepts
+    int list;               //ball and distribution: print every code / histogram bin
+    int nargs;
+    char **args;            //positional arguments after the mode
+};
+
+struct bench_case {
+    const char *name;
+    const char *backend;
+    size_t digits;          //wheels per code
+    size_t pairs;           //pairs per rep (batch size)
+    long long (*run)(void *ctx);
+    void *ctx;
+};
+
+struct bench_result {
+    long reps;
+    double ns_per_pair;
+    double ns_per_pair_var;
+    double ns_per_pair_min;
+    double digits_per_s;
+    double counters[LOCK_PERF_EVENTS];  //over all timed trials, -1 if missing
+    double digits_done;
+};
+
+static struct lock_perf bench_perf = { { -1, -1, -1, -1, -1 }, 0, 0 };
+
+void bench_measure(const struct bench_case *c, const struct lock_opts *o, struct bench_result *r) {
+    struct lock_perf_read before, after;
+    double sum = 0, sum2 = 0, best = 0;
+    long reps = 1, i;
+    int k;
+
+    for (;;) {
+        double t0 = now_seconds();
+        for (i = 0; i < reps; i++) {
+            lock_sink += c->run(c->ctx);
+        }
+        if (now_seconds() - t0 >= o->min_time || reps >= (1L << 30)) {
+            break;
+        }
+        reps *= 2;
+    }
+
+    lock_perf_sample(&bench_perf, &before);
+    for (k = 0; k < o->trials; k++) {
+        double t0 = now_seconds();
+        for (i = 0; i < reps; i++) {
+            lock_sink += c->run(c->ctx);
+        }
+        double ns = (now_seconds() - t0) * 1e9 / ((double)reps * c->pairs);
+        sum += ns;
+        sum2 += ns * ns;
+        if (k == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    lock_perf_sample(&bench_perf, &after);
+    lock_perf_delta(&bench_perf, &before, &after, r->counters);
+    r->digits_done = (double)reps * o->trials * c->pairs * c->digits;
+
+    r->reps = reps;
+    r->ns_per_pair = sum / o->trials;
+    r->ns_per_pair_var = (o->trials > 1) ? (sum2 - sum * sum / o->trials) / (o->trials - 1) : 0;
+    if (r->ns_per_pair_var < 0) {
+        r->ns_per_pair_var = 0;
+    }
+    r->ns_per_pair_min = best;
+    r->digits_per_s = c->digits * 1e9 / r->ns_per_pair;
+}
+
+static int bench_first = 1;
+
+// x / per as a JSON number, null if x is missing
+static void bench_ratio(const char *name, double x, double per) {
+    if (x < 0 || per <= 0) {
+        printf(", \"%s\": null", name);
+    }
+    else {
+        printf(", \"%s\": %.4f", name, x / per);
+    }
+}
+
+void bench_report(const struct bench_case *c, const struct lock_opts *o, const struct lock_pool_stats *st) {
+    struct bench_result r;
+    int i;
+
+    bench_measure(c, o, &r);
+
+    printf("%s    {\"name\": \"%s\", \"backend\": \"%s\", \"digits\": %zu, \"batch\": %zu, "
+           "\"trials\": %d, \"reps\": %ld, \"ns_per_pair\": %.4f, \"ns_per_pair_var\": %.6f, "
+           "\"ns_per_pair_min\": %.4f, \"digits_per_s\": %.0f",
+           bench_first ? "" : ",\n", c->name, c->backend, c->digits, c->pairs,
+           o->trials, r.reps, r.ns_per_pair, r.ns_per_pair_var, r.ns_per_pair_min, r.digits_per_s);
+    if (st != NULL) {
+        printf(", \"threads\": [");
+        for (i = 0; i < st->threads; i++) {
+            printf("%s{\"pairs\": %zu, \"chunks\": %zu, \"stolen\": %zu, \"pairs_per_s\": %.0f}",
+                   i ? ", " : "", st->items[i], st->chunks[i], st->stolen[i],
+                   st->busy[i] > 0 ? st->items[i] / st->busy[i] : 0.0);
+        }
+        printf("]");
+    }
+    if (bench_perf.open > 0) {
+        printf(", \"counters\": {\"ipc\": ");
+        if (r.counters[LOCK_PERF_INSTRUCTIONS] >= 0 && r.counters[LOCK_PERF_CYCLES] > 0) {
+            printf("%.3f", r.counters[LOCK_PERF_INSTRUCTIONS] / r.counters[LOCK_PERF_CYCLES]);
+        }
+        else {
+            printf("null");
+        }
+        bench_ratio("cycles_per_digit", r.counters[LOCK_PERF_CYCLES], r.digits_done);
+        bench_ratio("instructions_per_digit", r.counters[LOCK_PERF_INSTRUCTIONS], r.digits_done);
+        bench_ratio("branch_misses_per_digit", r.counters[LOCK_PERF_BRANCH_MISSES], r.digits_done);
+        bench_ratio("l1d_misses_per_digit", r.counters[LOCK_PERF_L1D_MISSES], r.digits_done);
+        bench_ratio("llc_misses_per_digit", r.counters[LOCK_PERF_LLC_MISSES], r.digits_done);
+        printf("}");
+    }
+    printf("}");
+    fflush(stdout);
+    bench_first = 0;
+}
+
+// Integer-code cases
+struct bench_int {
+    int N;
+    const int *S;
+    const int *E;
+    const uint64_t *SU;
+    const uint64_t *EU;
+    int *P;
+    size_t count;
+    struct lock_pool *pool;
+    struct lock_pool_stats *stats;
+};
+
+static long long run_unlocker(void *ctx) {
+    struct bench_int *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        sum += unlocker(b->N, b->S[k], b->E[k]);
+    }
+    return sum;
+}
+
+static long long run_batch(void *ctx) {
+    struct bench_int *b = ctx;
+
+    unlocker_batch(b->N, b->S, b->E, b->P, b->count);
+    return b->P[b->count / 2];
+}
+
+static long long run_lut(void *ctx) {
+    struct bench_int *b = ctx;
+
+    unlocker_batch_lut(b->N, b->S, b->E, b->P, b->count);
+    return b->P[b->count / 2];
+}
+
+static long long run_fixed(void *ctx) {
+    struct bench_int *b = ctx;
+
+    unlocker_batch_u64(b->N, b->SU, b->EU, b->P, b->count);
+    return b->P[b->count / 2];
+}
+
+static long long run_u64(void *ctx) {
+    struct bench_int *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        sum += unlocker_u64(b->N, b->SU[k], b->EU[k]);
+    }
+    return sum;
+}
+
+static long long run_pool(void *ctx) {
+    struct bench_int *b = ctx;
+
+    unlocker_batch_parallel(b->pool, b->N, b->S, b->E, b->P, b->count, b->stats);
+    return b->P[b->count / 2];
+}
+
+// Digit-string cases: count codes of len digits laid end to end
+struct bench_str {
+    size_t len;
+    size_t count;
+    const char *S;
+    const char *E;
+    const uint8_t *SD;
+    const uint8_t *ED;
+    long long (*digits)(size_t N, const char *S, const char *E);
+};
+
+static long long run_digits(void *ctx) {
+    struct bench_str *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        sum += b->digits(b->len, b->S + k * b->len, b->E + k * b->len);
+    }
+    return sum;
+}
+
+static long long run_bcd(void *ctx) {
+    struct bench_str *b = ctx;
+    size_t bytes = lock_bcd_bytes(b->len);
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        sum += unlocker_bcd(b->len, b->SD + k * bytes, b->ED + k * bytes);
+    }
+    return sum;
+}
+
+// Session cases: a rep is a run of moves on one long lock, each leaving the cost current,
+// so ns_per_pair is per move and digits_per_s is what a full recompute would have to reach
+struct bench_session {
+    struct lock_session *s;
+    const struct lock_move *moves;
+    size_t count;
+};
+
+static long long run_session_point(void *ctx) {
+    struct bench_session *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        lock_session_turn(b->s, b->moves[k].first, b->moves[k].value);
+        sum += lock_session_cost(b->s);
+    }
+    return sum;
+}
+
+static long long run_session_range(void *ctx) {
+    struct bench_session *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        lock_session_rotate(b->s, b->moves[k].first, b->moves[k].last, b->moves[k].value);
+        sum += lock_session_cost(b->s);
+    }
+    return sum;
+}
+
+static long long run_session_log(void *ctx) {
+    struct bench_session *b = ctx;
+
+    return lock_session_apply(b->s, b->moves, b->count, NULL);
+}
+
+// Range index cases: a full build on the pool, and random [l, r) queries against it
+struct bench_range {
+    struct lock_range_index *ix;
+    struct lock_pool *pool;
+    size_t n;
+    const char *S, *E;
+    const struct lock_move *spans;  //first / last of each query
+    size_t count;
+};
+
+static long long run_range_build(void *ctx) {
+    struct bench_range *b = ctx;
+    long long total;
+
+    lock_range_build(b->ix, b->pool, b->n, b->S, b->E, 0);
+    total = lock_range_cost(b->ix, 0, b->n);
+    lock_range_free(b->ix);
+    return total;
+}
+
+static long long run_range_query(void *ctx) {
+    struct bench_range *b = ctx;
+    long long sum = 0;
+    size_t k;
+
+    for (k = 0; k < b->count; k++) {
+        sum += lock_range_cost(b->ix, b->spans[k].first, b->spans[k].last);
+    }
+    return sum;
+}
+
+#define BENCH_MAX_PAIRS 100000
+#define BENCH_STR_DIGITS (1 << 20)
+#define BENCH_MOVES 4096
+
+int bench_suite(const struct lock_opts *o) {
+    static const size_t batches[] = { 16, 256, 4096, BENCH_MAX_PAIRS };
+    static const size_t lengths[] = { 4, 16, 64, 256, 1000, 10000, 100000, 1000000 };
+    static const int widths[] = { 3, 4, 6, 8 };
+    static struct lock_pool_stats stats;
+    int *S = malloc(BENCH_MAX_PAIRS * sizeof(int));
+    int *E = malloc(BENCH_MAX_PAIRS * sizeof(int));
+    int *P = malloc(BENCH_MAX_PAIRS * sizeof(int));
+    uint64_t *SU = malloc(BENCH_MAX_PAIRS * sizeof(uint64_t));
+    uint64_t *EU = malloc(BENCH_MAX_PAIRS * sizeof(uint64_t));
+    struct lock_workload w4, wl;
+    char *SL, *EL;
+    uint8_t *SD = malloc(lock_bcd_bytes(BENCH_STR_DIGITS));
+    uint8_t *ED = malloc(lock_bcd_bytes(BENCH_STR_DIGITS));
+    struct lock_pool *pool;
+    size_t k;
+    int b;
+
+    //Before the pool, so its threads inherit the counters
+    if (lock_perf_open(&bench_perf) == 0) {
+        fprintf(stderr, "no hardware counters (%s%s), timing only\n", strerror(bench_perf.err),
+                (bench_perf.err == EACCES || bench_perf.err == EPERM) ? ", see /proc/sys/kernel/perf_event_paranoid" : "");
+    }
+    pool = lock_pool_create(&o->pool);
+    if (S == NULL || E == NULL || P == NULL || SU == NULL || EU == NULL ||
+        SD == NULL || ED == NULL || pool == NULL) {
+        return 1;
+    }
+
+    //All inputs are generated (or loaded from the cache) before anything is timed
+    if (!lock_workload_cached(&w4, o->cache, o->seed, o->dist, BENCH_MAX_PAIRS, 4) ||
+        !lock_workload_cached(&wl, o->cache, o->seed, o->dist, 1, BENCH_STR_DIGITS)) {
+        return 1;
+    }
+    lock_workload_u64(&w4, SU, EU);
+    for (k = 0; k < BENCH_MAX_PAIRS; k++) {
+        S[k] = (int)SU[k];
+        E[k] = (int)EU[k];
+    }
+    SL = wl.S;
+    EL = wl.E;
+    lock_lut_init();
+
+    printf("{\n  \"backend\": \"%s\",\n  \"threads\": %d,\n  \"seed\": %llu,\n  \"dist\": \"%s\",\n  \"counters\": [",
+           lock_backend->name, pool->threads, (unsigned long long)o->seed, lock_dist_names[o->dist]);
+    for (b = 0, k = 0; b < LOCK_PERF_EVENTS; b++) {
+        if (bench_perf.fd[b] >= 0) {
+            printf("%s\"%s\"", k++ ? ", " : "", lock_perf_names[b]);
+        }
+    }
+    printf("],\n  \"results\": [\n");
+
+    //4-digit integer codes over batch sizes
+    for (k = 0; k < sizeof(batches) / sizeof(batches[0]); k++) {
+        struct bench_int bi = { 4, S, E, NULL, NULL, P, batches[k], NULL, NULL };
+        struct bench_case c = { "unlocker", "scalar", 4, batches[k], run_unlocker, &bi };
+
+        bench_report(&c, o, NULL);
+        c.name = "batch";
+        c.run = run_batch;
+        bench_report(&c, o, NULL);
+        c.name = "pair_table";
+        c.run = run_lut;
+        bench_report(&c, o, NULL);
+    }
+    if (lock_lut4_init()) {
+        struct bench_int bi = { 4, S, E, NULL, NULL, P, BENCH_MAX_PAIRS, NULL, NULL };
+        struct bench_case c = { "code_table", "scalar", 4, BENCH_MAX_PAIRS, run_lut, &bi };
+
+        bench_report(&c, o, NULL);
+        lock_lut4_free();
+    }
+
+    //Fixed-width kernels against the generic 64-bit path
+    for (b = 0; b < 4; b++) {
+        struct lock_workload ww;
+        struct bench_int bi = { widths[b], NULL, NULL, SU, EU, P, BENCH_MAX_PAIRS, NULL, NULL };
+        struct bench_case c = { "unlocker_u64", "scalar", widths[b], BENCH_MAX_PAIRS, run_u64, &bi };
+
+        if (!lock_workload_cached(&ww, o->cache, o->seed, o->dist, BENCH_MAX_PAIRS, widths[b])) {
+            return 1;
+        }
+        lock_workload_u64(&ww, SU, EU);
+        lock_workload_free(&ww);
+        bench_report(&c, o, NULL);
+        c.name = "fixed";
+        c.run = run_fixed;
+        bench_report(&c, o, NULL);
+    }
+
+    //Digit strings over code length and backend, ~1M digits per rep
+    lock_bcd_pack(SD, SL, BENCH_STR_DIGITS);
+    lock_bcd_pack(ED, EL, BENCH_STR_DIGITS);
+    for (k = 0; k < sizeof(lengths) / sizeof(lengths[0]) && lengths[k] <= o->max_digits; k++) {
+        struct bench_str bs = { lengths[k], BENCH_STR_DIGITS / lengths[k], SL, EL, SD, ED, NULL };
+        struct bench_case c = { "digits", NULL, lengths[k], bs.count, run_digits, &bs };
+
+        for (b = 0; b < LOCK_BACKENDS; b++) {
+            if (!lock_backends[b].supported() || (o->backend != NULL && strcmp(o->backend, lock_backends[b].name) != 0)) {
+                continue;
+            }
+            bs.digits = lock_backends[b].digits;
+            c.backend = lock_backends[b].name;
+            bench_report(&c, o, NULL);
+        }
+        //Packed BCD needs whole bytes per code
+        if (lengths[k] % 2 == 0) {
+            c.name = "bcd";
+            c.backend = "swar";
+            c.run = run_bcd;
+            bench_report(&c, o, NULL);
+        }
+    }
+
+    //Incremental costs on one BENCH_STR_DIGITS-wheel lock
+    {
+        static struct lock_move moves[BENCH_MOVES];
+        struct lock_session ses;
+        struct lock_draws d;
+        struct bench_session bs = { &ses, moves, BENCH_MOVES };
+        struct bench_case c = { "session_turn", "scalar", BENCH_STR_DIGITS, BENCH_MOVES, run_session_point, &bs };
+
+        if (!lock_session_init(&ses, BENCH_STR_DIGITS, SL, EL)) {
+            return 1;
+        }
+        lock_rng_seed(&d.rng, o->seed);
+        d.next = 64;
+        d.left = 0;
+        for (k = 0; k < BENCH_MOVES; k++) {
+            uint64_t from = lock_draw_wide(&d, BENCH_STR_DIGITS), to = lock_draw_wide(&d, BENCH_STR_DIGITS + 1);
+
+            moves[k].kind = LOCK_MOVE_TURN;
+            moves[k].value = 1 + lock_draw(&d, 9);
+            moves[k].first = (from < to) ? from : to;
+            moves[k].last = (from < to) ? to : from;
+        }
+        bench_report(&c, o, NULL);
+        c.name = "session_rotate";
+        c.run = run_session_range;
+        bench_report(&c, o, NULL);
+        c.name = "session_log";
+        c.run = run_session_log;
+        bench_report(&c, o, NULL);
+        lock_session_free(&ses);
+
+        //Same spans as range queries; digits is the mean span a substring call would scan
+        {
+            struct lock_range_index ix;
+            struct bench_range br = { &ix, pool, BENCH_STR_DIGITS, SL, EL, moves, BENCH_MOVES };
+            struct bench_case rc = { "range_build", "sse2", BENCH_STR_DIGITS, 1, run_range_build, &br };
+
+            bench_report(&rc, o, NULL);
+            if (!lock_range_build(&ix, pool, BENCH_STR_DIGITS, SL, EL, 0)) {
+                return 1;
+            }
+            rc.name = "range_query";
+            rc.backend = "scalar";
+            rc.digits = BENCH_STR_DIGITS / 3;
+            rc.pairs = BENCH_MOVES;
+            rc.run = run_range_query;
+            bench_report(&rc, o, NULL);
+            lock_range_free(&ix);
+            if (!lock_range_build(&ix, pool, BENCH_STR_DIGITS, SL, EL, 1)) {
+                return 1;
+            }
+            rc.name = "range_query_fenwick";
+            bench_report(&rc, o, NULL);
+            lock_range_free(&ix);
+        }
+    }
+
+    //Bulk job on the thread pool
+    {
+        struct bench_int bi = { 4, S, E, NULL, NULL, P, BENCH_MAX_PAIRS, pool, &stats };
+        struct bench_case c = { "pool_batch", "scalar", 4, BENCH_MAX_PAIRS, run_pool, &bi };
+
+        bench_report(&c, o, &stats);
+    }
+
+    printf("\n  ],\n  \"sink\": %lld\n}\n", (long long)lock_sink);
+
+    lock_pool_destroy(pool);
+    lock_perf_close(&bench_perf);
+    free(S);
+    free(E);
+    free(P);
+    free(SU);
+    free(EU);
+    lock_workload_free(&w4);
+    lock_workload_free(&wl);
+    free(SD);
+    free(ED);
+
+    return 0;
+}
+
+// Latency cases: one call per sample, on pair k of a pre-generated set
+struct lat_case {
+    const char *name;
+    const char *backend;
+    size_t digits;
+    long long (*call)(void *ctx, size_t k);
+    void *ctx;
+    size_t pairs;
+};
+
+struct lat_codes {
+    int N;
+    const uint64_t *S, *E;
+};
+
+struct lat_str {
+    size_t n;
+    const char *S, *E;
+    long long (*digits)(size_t N, const char *S, const char *E);
+};
+
+static long long lat_nop(void *ctx, size_t k) {
+    (void)ctx;
+    return (long long)k;
+}
+
+static long long lat_unlocker(void *ctx, size_t k) {
+    const struct lat_codes *c = ctx;
+    return unlocker(c->N, (int)c->S[k], (int)c->E[k]);
+}
+
+static long long lat_u64(void *ctx, size_t k) {
+    const struct lat_codes *c = ctx;
+    return unlocker_u64(c->N, c->S[k], c->E[k]);
+}
+
+static long long lat_fixed(void *ctx, size_t k) {
+    const struct lat_codes *c = ctx;
+    return unlocker_fixed(c->N, c->S[k], c->E[k]);
+}
+
+static long long lat_digits(void *ctx, size_t k) {
+    const struct lat_str *c = ctx;
+    return c->digits(c->n, c->S + k * c->n, c->E + k * c->n);
+}
+
+// Records samples calls into h, less the timer's own cost
+static void latency_run(const struct lat_case *c, size_t samples, uint64_t overhead, struct lock_hist *h) {
+    size_t i, k = 0;
+
+    lock_hist_reset(h);
+    //Warm up caches and predictors on the same pairs
+    for (i = 0; i < 1000; i++) {
+        lock_sink += c->call(c->ctx, i % c->pairs);
+    }
+    for (i = 0; i < samples; i++) {
+        uint64_t t0, t1;
+        long long r;
+
+        t0 = lock_tsc_start();
+        r = c->call(c->ctx, k);
+        t1 = lock_tsc_stop();
+        lock_sink += r;
+        lock_hist_add(h, (t1 - t0 > overhead) ? t1 - t0 - overhead : 0);
+        if (++k == c->pairs) {
+            k = 0;
+        }
+    }
+}
+
+static int lat_first = 1;
+
+static void latency_report(const struct lat_case *c, const struct lock_hist *h, double tpns) {
+    printf("%s    {\"name\": \"%s\", \"backend\": \"%s\", \"digits\": %zu, \"samples\": %llu, \"min_ns\": %.1f, \"mean_ns\": %.1f, "
+           "\"p50_ns\": %.1f, \"p99_ns\": %.1f, \"p999_ns\": %.1f, \"max_ns\": %.1f}",
+           lat_first ? "" : ",\n", c->name, c->backend, c->digits, (unsigned long long)h->count, h->min / tpns, h->sum / h->count / tpns,
+           lock_hist_quantile(h, 0.5) / tpns, lock_hist_quantile(h, 0.99) / tpns, lock_hist_quantile(h, 0.999) / tpns, h->max / tpns);
+    fflush(stdout);
+    lat_first = 0;
+}
+
+// Whether cpu is in a kernel CPU list such as "2-3,6"
+static int lock_cpu_listed(const char *list, int cpu) {
+    while (*list >= '0' && *list <= '9') {
+        char *end;
+        long lo = strtol(list, &end, 10), hi = lo;
+
+        if (*end == '-') {
+            hi = strtol(end + 1, &end, 10);
+        }
+        if (cpu >= lo && cpu <= hi) {
+            return 1;
+        }
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return 0;
+}
+
+// First line of a sysfs file, "" if there isn't one
+static void lock_read_line(const char *path, char *buf, size_t size) {
+    FILE *f = fopen(path, "r");
+
+    buf[0] = '\0';
+    if (f != NULL) {
+        if (fgets(buf, (int)size, f) == NULL) {
+            buf[0] = '\0';
+        }
+        buf[strcspn(buf, "\n")] = '\0';
+        fclose(f);
+    }
+}
+
+// Picks the CPU to run on (the first isolated one if any) and prints what could make
+// the numbers noisier. Returns the CPU, pinned if pin is set.
+static int latency_setup(int pin) {
+    char isolated[256], line[256], path[128];
+    int cpu = sched_getcpu();
+
+    lock_read_line("/sys/devices/system/cpu/isolated", isolated, sizeof(isolated));
+    if (pin) {
+        if (isolated[0] >= '0' && isolated[0] <= '9') {
+            cpu = atoi(isolated);
+        }
+        lock_pool_pin(pthread_self(), cpu);
+    }
+    else {
+        fprintf(stderr, "hint: --pin keeps the thread on one CPU\n");
+    }
+    if (!lock_cpu_listed(isolated, cpu)) {
+        fprintf(stderr, "hint: CPU %d isn't isolated (isolcpus=, nohz_full= and rcu_nocbs= on the kernel command line)\n", cpu);
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor", cpu);
+    lock_read_line(path, line, sizeof(line));
+    if (line[0] != '\0' && strcmp(line, "performance") != 0) {
+        fprintf(stderr, "hint: CPU %d uses the %s governor, performance avoids frequency ramps\n", cpu, line);
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", cpu);
+    lock_read_line(path, line, sizeof(line));
+    if (strpbrk(line, ",-") != NULL) {
+        fprintf(stderr, "hint: CPU %d shares a core with %s; keep the siblings idle\n", cpu, line);
+    }
+    if (!lock_tsc_invariant()) {
+        fprintf(stderr, "hint: no invariant TSC, tick counts may drift with frequency\n");
+    }
+
+    return cpu;
+}
+
+#define LAT_SET_DIGITS (1 << 22)    //Digits per side in each case's pair set
+
+// locks latency [--count=SAMPLES --max-digits= --backend= --pin --seed= --dist=]
+int latency_suite(const struct lock_opts *o) {
+    static const size_t lengths[] = { 4, 16, 64, 256, 1024, 4096 };
+    static const int widths[] = { 3, 4, 6, 8 };
+    static struct lock_hist h;
+    struct lock_workload w;
+    struct lat_codes lc;
+    uint64_t *S, *E;
+    uint64_t overhead;
+    size_t pairs, k;
+    double tpns;
+    int cpu, b;
+
+    cpu = latency_setup(o->pool.pin);
+    tpns = lock_tsc_calibrate();
+
+    //Timer cost: the fastest an empty call through the same path ever measures
+    {
+        struct lat_case nop = { "nop", "none", 0, lat_nop, NULL, 1 };
+
+        latency_run(&nop, 100000, 0, &h);
+        overhead = h.min;
+    }
+
+    printf("{\n  \"tsc_ghz\": %.4f,\n  \"invariant_tsc\": %s,\n  \"cpu\": %d,\n  \"pinned\": %s,\n  \"overhead_ns\": %.1f,\n  \"results\": [\n",
+           tpns, lock_tsc_invariant() ? "true" : "false", cpu, o->pool.pin ? "true" : "false", overhead / tpns);
+
+    //Integer codes: the original call, the generic 64-bit path and the fixed-width kernels
+    pairs = (o->count < (1 << 16)) ? o->count : (1 << 16);
+    pairs = (pairs < 1) ? 1 : pairs;
+    S = malloc(pairs * sizeof(uint64_t));
+    E = malloc(pairs * sizeof(uint64_t));
+    if (S == NULL || E == NULL) {
+        return 1;
+    }
+    for (b = 0; b < 4; b++) {
+        struct lat_case c = { "unlocker_u64", "scalar", (size_t)widths[b], lat_u64, &lc, pairs };
+
+        if (!lock_workload_cached(&w, o->cache, o->seed, o->dist, pairs, (size_t)widths[b])) {
+            return 1;
+        }
+        lock_workload_u64(&w, S, E);
+        lock_workload_free(&w);
+        lc.N = widths[b];
+        lc.S = S;
+        lc.E = E;
+
+        if (widths[b] == 4) {
+            c.name = "unlocker";
+            c.call = lat_unlocker;
+            latency_run(&c, o->count, overhead, &h);
+            latency_report(&c, &h, tpns);
+            c.name = "unlocker_u64";
+            c.call = lat_u64;
+        }
+        latency_run(&c, o->count, overhead, &h);
+        latency_report(&c, &h, tpns);
+        c.name = "fixed";
+        c.call = lat_fixed;
+        latency_run(&c, o->count, overhead, &h);
+        latency_report(&c, &h, tpns);
+    }
+    free(S);
+    free(E);
+
+    //Digit strings per length and backend
+    for (k = 0; k < sizeof(lengths) / sizeof(lengths[0]) && lengths[k] <= o->max_digits; k++) {
+        struct lat_str ls;
+        struct lat_case c = { "digits", NULL, lengths[k], lat_digits, &ls, 0 };
+
+        pairs = LAT_SET_DIGITS / lengths[k];
+        pairs = (o->count < pairs) ? o->count : pairs;
+        pairs = (pairs < 1) ? 1 : pairs;
+        if (!lock_workload_cached(&w, o->cache, o->seed, o->dist, pairs, lengths[k])) {
+            return 1;
+        }
+        ls.n = lengths[k];
+        ls.S = w.S;
+        ls.E = w.E;
+        c.pairs = pairs;
+        for (b = 0; b < LOCK_BACKENDS; b++) {
+            if (!lock_backends[b].supported() || (o->backend != NULL && strcmp(o->backend, lock_backends[b].name) != 0)) {
+                continue;
+            }
+            ls.digits = lock_backends[b].digits;
+            c.backend = lock_backends[b].name;
+            latency_run(&c, o->count, overhead, &h);
+            latency_report(&c, &h, tpns);
+        }
+        lock_workload_free(&w);
+    }
+
+    printf("\n  ],\n  \"sink\": %lld\n}\n", (long long)lock_sink);
+
+    return 0;
+}
+
+// locks corpus-gen OUT [--count= --width= --dist= --seed= --bcd --variable]
+int corpus_gen_main(const struct lock_opts *o) {
+    double t0 = now_seconds();
+
+    if (o->nargs != 1) {
+        fprintf(stderr, "usage: corpus-gen OUT [--count=N] [--width=N] [--dist=D] [--seed=N] [--bcd] [--variable]\n");
+        return 1;
+    }
+    if (!lock_corpus_generate(o->args[0], o->seed, o->dist, o->count, o->width, o->corpus_flags)) {
+        fprintf(stderr, "can't write %s\n", o->args[0]);
+        return 1;
+    }
+    printf("{\"pairs\": %zu, \"width\": %zu, \"seconds\": %f}\n", o->count, o->width, now_seconds() - t0);
+
+    return 0;
+}
+
+// locks corpus-score IN OUT [--threads= --chunk= --pin]
+int corpus_score_main(const struct lock_opts *o) {
+    static struct lock_pool_stats stats;
+    struct lock_corpus c;
+    struct lock_results r;
+    struct lock_pool *pool;
+    size_t k, digits = 0;
+    int i, ok;
+
+    if (o->nargs != 2) {
+        fprintf(stderr, "usage: corpus-score IN OUT [--threads=N] [--chunk=N] [--pin]\n");
+        return 1;
+    }
+    if (!lock_corpus_open(&c, o->args[0])) {
+        fprintf(stderr, "%s is not a readable corpus\n", o->args[0]);
+        return 1;
+    }
+    if (!lock_results_create(&r, o->args[1], c.h->count)) {
+        fprintf(stderr, "can't create %s\n", o->args[1]);
+        lock_corpus_close(&c);
+        return 1;
+    }
+    if ((pool = lock_pool_create(&o->pool)) == NULL) {
+        return 1;
+    }
+
+    lock_corpus_score(pool, &c, r.cost, &stats);
+    if (c.offsets != NULL) {
+        for (k = 0; k < c.h->count; k++) {
+            const uint8_t *S, *E;
+            digits += lock_corpus_record(&c, k, &S, &E);
+        }
+    }
+    else {
+        digits = c.h->count * ((c.h->flags & LOCK_CORPUS_BCD) ? 2 * c.code_bytes : c.code_bytes);
+    }
+
+    printf("{\"pairs\": %llu, \"digits\": %zu, \"seconds\": %f, \"pairs_per_s\": %.0f, \"digits_per_s\": %.0f, \"threads\": [",
+           (unsigned long long)c.h->count, digits, stats.seconds, c.h->count / stats.seconds, digits / stats.seconds);
+    for (i = 0; i < stats.threads; i++) {
+        printf("%s{\"pairs\": %zu, \"pairs_per_s\": %.0f}", i ? ", " : "", stats.items[i],
+               stats.busy[i] > 0 ? stats.items[i] / stats.busy[i] : 0.0);
+    }
+    printf("]}\n");
+
+    lock_pool_destroy(pool);
+    ok = lock_results_close(&r);
+    lock_corpus_close(&c);
+
+    return ok ? 0 : 1;
+}
+
+// locks stream [FILE] [--stats]: "S E" lines from FILE or stdin, costs to stdout
+int stream_main(const struct lock_opts *o) {
+    struct lock_stream_stats st;
+    int in = 0;
+    int ok;
+
+    if (o->nargs > 1) {
+        fprintf(stderr, "usage: stream [FILE] [--stats]\n");
+        return 1;
+    }
+    if (o->nargs == 1 && (in = open(o->args[0], O_RDONLY)) < 0) {
+        fprintf(stderr, "can't open %s\n", o->args[0]);
+        return 1;
+    }
+    if (in != 0) {
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    ok = lock_stream(in, 1, &st);
+    if (o->stats) {
+        fprintf(stderr, "{\"bytes\": %zu, \"lines\": %zu, \"malformed\": %zu, \"seconds\": %f, \"bytes_per_s\": %.0f}\n",
+                st.bytes, st.lines, st.bad, st.seconds, st.bytes / st.seconds);
+    }
+    if (in != 0) {
+        close(in);
+    }
+
+    return ok ? 0 : 1;
+}
+
+// locks pipeline IN OUT [--threads= --chunk= --depth= --engine=uring|threads]
+int pipeline_main(const struct lock_opts *o) {
+    struct lock_pipe_stats st;
+
+    if (o->nargs != 2) {
+        fprintf(stderr, "usage: pipeline IN OUT [--threads=N] [--chunk=RECORDS] [--depth=N] [--engine=uring|threads]\n");
+        return 1;
+    }
+
+    if (!lock_pipeline(o->args[0], o->args[1], o->engine, o->pool.threads, o->pool.chunk, o->depth, &st)) {
+        return 1;
+    }
+    printf("{\"engine\": \"%s\", \"pairs\": %zu, \"seconds\": %f, \"pairs_per_s\": %.0f, \"bytes_per_s\": %.0f, "
+           "\"read_s\": %f, \"write_s\": %f, \"driver_wait_s\": %f, \"queue_wait_s\": %f, \"worker_wait_s\": %f, \"workers\": %d, \"bound\": \"%s\"}\n",
+           st.engine != NULL ? st.engine : "none", st.pairs, st.seconds, st.pairs / st.seconds, st.bytes_read / st.seconds,
+           st.read_s, st.write_s, st.driver_wait_s, st.queue_wait_s, st.worker_wait_s, st.workers,
+           (st.workers > 0 && st.worker_wait_s / st.workers > 0.5 * st.seconds) ? "io" : "compute");
+
+    return 0;
+}
+
+// locks serve ADDR: answers queries until SIGINT/SIGTERM, then prints stats
+int serve_main(const struct lock_opts *o) {
+    struct lock_serve_stats st;
+
+    if (o->nargs != 1) {
+        fprintf(stderr, "usage: serve unix:PATH|tcp:PORT\n");
+        return 1;
+    }
+    if (!lock_serve(o->args[0], &st)) {
+        return 1;
+    }
+    fprintf(stderr, "{\"connections\": %zu, \"queries\": %zu, \"text_queries\": %zu, \"batches\": %zu, \"mean_batch\": %.1f, \"largest_batch\": %zu, \"seconds\": %f}\n",
+            st.connections, st.queries, st.text_queries, st.batches, st.batches ? (double)(st.queries - st.text_queries) / st.batches : 0.0,
+            st.largest_batch, st.seconds);
+
+    return 0;
+}
+
+// locks loadgen ADDR [--threads= --depth= --count= --width= --dist= --seed=]
+int loadgen_main(const struct lock_opts *o) {
+    struct lock_load_stats st;
+    struct lock_workload w;
+    int clients = o->pool.threads > 0 ? o->pool.threads : 1;
+    int ok;
+
+    if (o->nargs != 1) {
+        fprintf(stderr, "usage: loadgen unix:PATH|tcp:PORT [--threads=CONNECTIONS] [--depth=N] [--count=N] [--width=N] [--dist=D] [--seed=N]\n");
+        return 1;
+    }
+    if (!lock_workload_cached(&w, o->cache, o->seed, o->dist, o->count, o->width)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    ok = lock_load(o->args[0], &w, clients, o->depth, &st);
+    if (ok) {
+        printf("{\"connections\": %d, \"depth\": %d, \"queries\": %zu, \"width\": %zu, \"seconds\": %f, \"qps\": %.0f, "
+               "\"p50_us\": %.1f, \"p99_us\": %.1f, \"p999_us\": %.1f, \"max_us\": %.1f, \"wrong\": %zu}\n",
+               clients, o->depth, st.queries, w.width, st.seconds, st.queries / st.seconds,
+               st.p50 * 1e6, st.p99 * 1e6, st.p999 * 1e6, st.max * 1e6, st.wrong);
+    }
+    else {
+        fprintf(stderr, "can't complete the run against %s\n", o->args[0]);
+    }
+    lock_workload_free(&w);
+
+    return (ok && st.wrong == 0) ? 0 : 1;
+}
+
+// Brute-force check of one query against every code in the dictionary
+static int nearest_check(const struct lock_dict *d, uint64_t S, const struct lock_hit *hits, size_t found, size_t k, int budget, size_t within) {
+    size_t below = 0, at = 0, inside = 0, i;
+    int kth = (found > 0) ? hits[found - 1].cost : -1;
+
+    for (i = 0; i < d->count; i++) {
+        int cost = unlocker_u64(d->N, d->code[i], S);
+        below += (cost < kth);
+        at += (cost == kth);
+        inside += (cost <= budget);
+    }
+    for (i = 0; i < found; i++) {
+        if (hits[i].cost != unlocker_u64(d->N, hits[i].code, S)) {
+            return 0;
+        }
+    }
+    //The k-th cost is right when fewer than k codes beat it and enough tie with it
+    return found == ((d->count < k) ? d->count : k) && below < found && below + at >= found && inside == within;
+}
+
+// locks nearest [--count= --width= --dist= --seed= --threads= --k= --budget=]: indexes
+// the S codes of a workload and times queries for the E codes against it
+int nearest_main(const struct lock_opts *o) {
+    static struct lock_hist hk, hb;
+    size_t queries = (o->count < 10000) ? o->count : 10000, k = (o->k > 0) ? (size_t)o->k : 1, i;
+    size_t within_total = 0, wrong = 0, *found;
+    struct lock_workload w;
+    struct lock_pool *pool;
+    struct lock_dict d;
+    struct lock_hit *hits;
+    uint64_t *S, *E;
+    double tpns, t0, build_s, batch_s;
+
+    if (o->width > 19) {
+        fprintf(stderr, "nearest takes codes of up to 19 digits\n");
+        return 1;
+    }
+    if (!lock_workload_cached(&w, o->cache, o->seed, o->dist, o->count, o->width)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    S = malloc(o->count * sizeof(uint64_t) + 1);
+    E = malloc(o->count * sizeof(uint64_t) + 1);
+    hits = malloc(queries * k * sizeof(struct lock_hit) + 1);
+    found = malloc(queries * sizeof(size_t) + 1);
+    if (S == NULL || E == NULL || hits == NULL || found == NULL || (pool = lock_pool_create(&o->pool)) == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    lock_workload_u64(&w, S, E);
+    lock_workload_free(&w);
+
+    t0 = now_seconds();
+    if (!lock_dict_build(&d, pool, (int)o->width, S, o->count)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    build_s = now_seconds() - t0;
+
+    //One query at a time for latency, then all of them on the pool for throughput
+    tpns = lock_tsc_calibrate();
+    lock_hist_reset(&hk);
+    lock_hist_reset(&hb);
+    for (i = 0; i < queries; i++) {
+        uint64_t t1 = lock_tsc_start();
+        found[i] = lock_dict_nearest(&d, E[i], k, hits + i * k);
+        lock_hist_add(&hk, lock_tsc_stop() - t1);
+    }
+    for (i = 0; i < queries; i++) {
+        uint64_t t1 = lock_tsc_start();
+        size_t n = lock_dict_within(&d, E[i], o->budget, NULL, 0);
+        lock_hist_add(&hb, lock_tsc_stop() - t1);
+        within_total += n;
+        //Spot-check the first few against a full scan
+        if (i < 16 && !nearest_check(&d, E[i], hits + i * k, found[i], k, o->budget, n)) {
+            wrong++;
+        }
+    }
+    t0 = now_seconds();
+    lock_dict_nearest_batch(pool, &d, E, queries, k, hits, found);
+    batch_s = now_seconds() - t0;
+
+    printf("{\"codes\": %zu, \"unique\": %zu, \"width\": %zu, \"table_levels\": %d, \"build_s\": %f, \"queries\": %zu, \"k\": %zu, \"budget\": %d,\n"
+           " \"nearest\": {\"mean_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f, \"batch_qps\": %.0f},\n"
+           " \"within\": {\"mean_hits\": %.2f, \"mean_us\": %.2f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"max_us\": %.2f},\n"
+           " \"threads\": %d, \"wrong\": %zu}\n",
+           o->count, d.count, o->width, d.levels, build_s, queries, k, o->budget,
+           hk.sum / hk.count / tpns / 1e3, lock_hist_quantile(&hk, 0.5) / tpns / 1e3, lock_hist_quantile(&hk, 0.99) / tpns / 1e3, hk.max / tpns / 1e3,
+           queries / batch_s, (double)within_total / queries,
+           hb.sum / hb.count / tpns / 1e3, lock_hist_quantile(&hb, 0.5) / tpns / 1e3, lock_hist_quantile(&hb, 0.99) / tpns / 1e3, hb.max / tpns / 1e3,
+           pool->threads, wrong);
+
+    lock_dict_free(&d);
+    lock_pool_destroy(pool);
+    free(S);
+    free(E);
+    free(hits);
+    free(found);
+
+    return (wrong == 0) ? 0 : 1;
+}
+
+// locks ball S K [--list]: how many codes are within K turns of S, or with --list the
+// codes themselves, one per line
+int ball_main(const struct lock_opts *o) {
+    struct lock_big count = { 0 };
+    size_t N;
+    double t0 = now_seconds();
+    char *s;
+    int k;
+
+    if (o->nargs != 2 || (N = strlen(o->args[0])) == 0 || strspn(o->args[0], "0123456789") != N) {
+        fprintf(stderr, "usage: ball S K [--list]\n");
+        return 1;
+    }
+    k = atoi(o->args[1]);
+
+    if (o->list) {
+        struct lock_ball_iter it;
+        const char *code;
+
+        if (!lock_ball_begin(&it, N, o->args[0], k)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        while ((code = lock_ball_next(&it)) != NULL) {
+            fputs(code, stdout);
+            putchar('\n');
+        }
+        lock_ball_end(&it);
+        return 0;
+    }
+
+    if (N > LOCK_BALL_MAX_DIGITS) {
+        fprintf(stderr, "can only count balls of up to %d digits\n", LOCK_BALL_MAX_DIGITS);
+        return 1;
+    }
+    if (!lock_ball_count(N, k, &count) || (s = lock_big_str(&count)) == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    printf("{\"digits\": %zu, \"k\": %d, \"count\": \"%s\", \"count_digits\": %zu, \"seconds\": %f}\n",
+           N, k, s, strlen(s), now_seconds() - t0);
+    free(s);
+    lock_big_free(&count);
+
+    return 0;
+}
+
+// locks distribution [--width=N --dist=D --list]: exact statistics of the cost of random
+// N-wheel pairs, and with --list the whole histogram
+int distribution_main(const struct lock_opts *o) {
+    static const double qs[] = { 0.001, 0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99, 0.999 };
+    struct lock_cost_dist cd;
+    double t0 = now_seconds(), seconds, best = -1;
+    size_t i, mode = 0;
+
+    if (!lock_cost_dist(&cd, o->width, o->dist)) {
+        fprintf(stderr, "no exact distribution for %zu wheels of %s codes\n", o->width, lock_dist_names[o->dist]);
+        return 1;
+    }
+    seconds = now_seconds() - t0;
+    for (i = 0; i < cd.len; i++) {
+        if (cd.p[i] > best) {
+            best = cd.p[i];
+            mode = cd.lo + i;
+        }
+    }
+
+    printf("{\"digits\": %zu, \"dist\": \"%s\", \"method\": \"%s\", \"seconds\": %f, \"mean\": %.6f, \"variance\": %.6f, \"stddev\": %.6f, "
+           "\"mode\": %zu, \"mode_p\": %.6g, \"quantiles\": {",
+           cd.N, lock_dist_names[o->dist], cd.fft ? "fft" : "dp", seconds, cd.mean, cd.var, sqrt(cd.var), mode, best);
+    for (i = 0; i < sizeof(qs) / sizeof(qs[0]); i++) {
+        printf("%s\"%g\": %zu", i ? ", " : "", qs[i], lock_cost_dist_quantile(&cd, qs[i]));
+    }
+    printf("}");
+    if (o->list) {
+        int first = 1;
+
+        printf(", \"histogram\": [");
+        for (i = 0; i < cd.len; i++) {
+            if (cd.p[i] > 0) {
+                printf("%s[%zu, %.17g]", first ? "" : ", ", cd.lo + i, cd.p[i]);
+                first = 0;
+            }
+        }
+        printf("]");
+    }
+    printf("}\n");
+    lock_cost_dist_free(&cd);
+
+    return 0;
+}
+
+// locks shortest S E [DEADFILE] [--count= --seed= --threads=]: fewest turns from S to E
+// (N = digits of S) avoiding the deadends listed in DEADFILE, or --count random ones
+int shortest_main(const struct lock_opts *o) {
+    struct lock_bfs_stats st;
+    struct lock_pool *pool;
+    uint32_t *dead = NULL;
+    size_t N, ndead = 0, states;
+    long long turns;
+    int ok;
+
+    if (o->nargs < 2 || o->nargs > 3 || (N = strlen(o->args[0])) == 0 || N > LOCK_BFS_MAX_DIGITS ||
+        strspn(o->args[0], "0123456789") != N || strlen(o->args[1]) != N || strspn(o->args[1], "0123456789") != N) {
+        fprintf(stderr, "usage: shortest S E [DEADFILE] [--count=DEADENDS] [--seed=N] [--threads=N] (S and E of equal length, up to %d digits)\n",
+                LOCK_BFS_MAX_DIGITS);
+        return 1;
+    }
+    states = ipow(10, (int)N);
+
+    if (o->nargs == 3) {
+        FILE *f = fopen(o->args[2], "r");
+        unsigned long long v;
+        size_t cap = 0;
+
+        if (f == NULL) {
+            perror(o->args[2]);
+            return 1;
+        }
+        while (fscanf(f, "%llu", &v) == 1) {
+            if (ndead == cap) {
+                uint32_t *p = realloc(dead, (cap = 2 * cap + 1024) * sizeof(uint32_t));
+                if (p == NULL) {
+                    fprintf(stderr, "out of memory\n");
+                    fclose(f);
+                    return 1;
+                }
+                dead = p;
+            }
+            if (v >= states) {
+                fprintf(stderr, "deadend %llu has more than %zu digits\n", v, N);
+                fclose(f);
+                return 1;
+            }
+            dead[ndead++] = (uint32_t)v;
+        }
+        fclose(f);
+    }
+    else {
+        struct lock_draws d;
+
+        if ((dead = malloc(o->count * sizeof(uint32_t) + 1)) == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        lock_rng_seed(&d.rng, o->seed);
+        d.next = 64;
+        d.left = 0;
+        for (ndead = 0; ndead < o->count; ndead++) {
+            dead[ndead] = (uint32_t)lock_draw_wide(&d, states);
+        }
+    }
+
+    if ((pool = lock_pool_create(&o->pool)) == NULL) {
+        free(dead);
+        return 1;
+    }
+    ok = lock_shortest(pool, (int)N, (uint32_t)strtoul(o->args[0], NULL, 10), (uint32_t)strtoul(o->args[1], NULL, 10), dead, ndead, &turns, &st);
+    if (ok) {
+        printf("{\"digits\": %zu, \"deadends\": %zu, \"turns\": %lld, \"unblocked_turns\": %d, \"method\": \"%s\", \"levels\": %d, "
+               "\"visited\": %zu, \"peak_frontier\": %zu, \"threads\": %d, \"seconds\": %f}\n",
+               N, ndead, turns, unlocker_u64((int)N, strtoull(o->args[0], NULL, 10), strtoull(o->args[1], NULL, 10)),
+               st.formula ? "formula" : "bfs", st.levels, st.visited, st.peak_frontier, pool->threads, st.seconds);
+    }
+    else {
+        fprintf(stderr, "out of memory\n");
+    }
+    lock_pool_destroy(pool);
+    free(dead);
+
+    return ok ? 0 : 1;
+}
+
+// locks check [--threads=]: after the backend self-check, each index and incremental
+// structure against a brute-force reference on random inputs from LOCK_CHECK_SEED, the
+// pooled paths on --threads workers. Build with
+// -fsanitize=address,undefined (or thread, with --threads above 1) to run the same checks
+// under the sanitizers.
+int check_main(const struct lock_opts *o) {
+    struct lock_pool *pool;
+    int session, range, dict, ball, dist, shortest, bad;
+
+    if ((pool = lock_pool_create(&o->pool)) == NULL) {
+        return 1;
+    }
+    session = lock_session_check(LOCK_CHECK_SEED);
+    range = lock_range_check(pool, LOCK_CHECK_SEED);
+    dict = lock_dict_check(pool, LOCK_CHECK_SEED);
+    ball = lock_ball_check(LOCK_CHECK_SEED);
+    dist = lock_cost_dist_check();
+    shortest = lock_shortest_check(pool, LOCK_CHECK_SEED);
+    bad = session + range + dict + ball + dist + shortest;
+    printf("{\"seed\": %d, \"threads\": %d, \"backends\": 0, \"session\": %d, \"range\": %d, \"dict\": %d, \"ball\": %d, "
+           "\"distribution\": %d, \"shortest\": %d}\n", LOCK_CHECK_SEED, pool->threads, session, range, dict, ball, dist, shortest);
+    lock_pool_destroy(pool);
+
+    return (bad == 0) ? 0 : 1;
+}
+
+#ifdef LOCK_PYTHON_MODULE
+// CPython extension "combination_locks", built from this same file:
+//
+//   gcc -O3 -pthread -shared -fPIC -DLOCK_PYTHON_MODULE $(python3-config --includes)
+//       -o combination_locks$(python3-config --extension-suffix) "Combination Locks in C with x86_64 Intel Assembly.c"
+//
+// Inputs are anything with the buffer protocol (array.array, NumPy arrays, memoryviews,
+// bytes), read in place. Costs are written as C ints into out= if given, otherwise into a
+// new bytearray returned as a memoryview of format 'i' (numpy.asarray() takes it without
+// copying). No Python object is made per element and the GIL is released while the
+// kernels run, so several threads can score at once.
+
+// Gets a C-contiguous buffer of integers; *sign says whether they're signed
+static int lock_py_codes(PyObject *obj, Py_buffer *view, int *sign) {
+    const char *f;
+
+    if (PyObject_GetBuffer(obj, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+        return 0;
+    }
+    f = view->format != NULL ? view->format : "B";
+    if (*f == '@' || *f == '=' || *f == '<') {
+        f++;
+    }
+    if (f[0] == '\0' || f[1] != '\0' || strchr("bBhHiIlLqQnN", f[0]) == NULL ||
+        (view->itemsize != 1 && view->itemsize != 2 && view->itemsize != 4 && view->itemsize != 8)) {
+        PyErr_Format(PyExc_TypeError, "codes must be a buffer of integers, not format '%s'", f);
+        PyBuffer_Release(view);
+        return 0;
+    }
+    *sign = (f[0] >= 'a');
+
+    return 1;
+}
+
+// Widens count codes from a buffer of any integer width
+static void lock_py_widen(uint64_t *dst, const char *src, Py_ssize_t itemsize, int sign, size_t count) {
+    size_t k;
+
+    switch (itemsize * 2 + sign) {
+    case 2: for (k = 0; k < count; k++) dst[k] = ((const uint8_t *)src)[k]; break;
+    case 3: for (k = 0; k < count; k++) dst[k] = (uint64_t)(int64_t)((const int8_t *)src)[k]; break;
+    case 4: for (k = 0; k < count; k++) dst[k] = ((const uint16_t *)src)[k]; break;
+    case 5: for (k = 0; k < count; k++) dst[k] = (uint64_t)(int64_t)((const int16_t *)src)[k]; break;
+    case 8: for (k = 0; k < count; k++) dst[k] = ((const uint32_t *)src)[k]; break;
+    case 9: for (k = 0; k < count; k++) dst[k] = (uint64_t)(int64_t)((const int32_t *)src)[k]; break;
+    default: memcpy(dst, src, count * sizeof(uint64_t)); break;
+    }
+}
+
+// Whether every widened code is a real N-digit code: a negative item from a signed buffer
+// comes out of lock_py_widen sign-extended, so it lands past max as well (or, for N = 20,
+// where every uint64_t fits, is caught by its sign).
+static int lock_py_in_range(const uint64_t *v, size_t count, int sign, uint64_t max) {
+    size_t k;
+
+    for (k = 0; k < count; k++) {
+        if (v[k] > max || (sign && (int64_t)v[k] < 0)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// out= if given (checked for size and format), otherwise a fresh int buffer. Returns the
+// object to hand back, with a writable view of it in *view.
+static PyObject *lock_py_out(PyObject *out, Py_ssize_t count, Py_buffer *view) {
+    PyObject *bytes, *mv, *cast;
+
+    if (out != NULL && out != Py_None) {
+        const char *f;
+
+        if (PyObject_GetBuffer(out, view, PyBUF_WRITABLE | PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0) {
+            return NULL;
+        }
+        f = view->format != NULL ? view->format : "B";
+        if (*f == '@' || *f == '=' || *f == '<') {
+            f++;
+        }
+        if (view->itemsize != sizeof(int) || view->len != count * (Py_ssize_t)sizeof(int) || strcmp(f, "i") != 0) {
+            PyErr_SetString(PyExc_ValueError, "out must be a writable buffer of C ints, one per code");
+            PyBuffer_Release(view);
+            return NULL;
+        }
+        Py_INCREF(out);
+        return out;
+    }
+
+    if ((bytes = PyByteArray_FromStringAndSize(NULL, count * (Py_ssize_t)sizeof(int))) == NULL) {
+        return NULL;
+    }
+    mv = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (mv == NULL) {
+        return NULL;
+    }
+    cast = PyObject_CallMethod(mv, "cast", "s", "i");
+    Py_DECREF(mv);
+    if (cast == NULL) {
+        return NULL;
+    }
+    if (PyObject_GetBuffer(cast, view, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+        Py_DECREF(cast);
+        return NULL;
+    }
+
+    return cast;
+}
+
+// costs(N, S, E, out=None): cost of every pair over the lowest N (<= 20) digits
+static PyObject *lock_py_costs(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = { "N", "S", "E", "out", NULL };
+    PyObject *Sobj, *Eobj, *out = NULL, *res;
+    Py_buffer s, e, o;
+    int N, ssign, esign, bad = 0;
+    size_t count, k, m;
+    uint64_t max;
+
+    (void)self;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iOO|O", kwlist, &N, &Sobj, &Eobj, &out)) {
+        return NULL;
+    }
+    if (N < 0 || N > 20) {
+        PyErr_SetString(PyExc_ValueError, "N must be 0..20 for integer codes (use costs_text for longer ones)");
+        return NULL;
+    }
+    max = (N < 20) ? ipow(10, N) - 1 : UINT64_MAX;
+    if (!lock_py_codes(Sobj, &s, &ssign)) {
+        return NULL;
+    }
+    if (!lock_py_codes(Eobj, &e, &esign)) {
+        PyBuffer_Release(&s);
+        return NULL;
+    }
+    count = (size_t)(s.len / s.itemsize);
+    if ((size_t)(e.len / e.itemsize) != count) {
+        PyErr_SetString(PyExc_ValueError, "S and E must have the same length");
+        PyBuffer_Release(&s);
+        PyBuffer_Release(&e);
+        return NULL;
+    }
+    if ((res = lock_py_out(out, (Py_ssize_t)count, &o)) == NULL) {
+        PyBuffer_Release(&s);
+        PyBuffer_Release(&e);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if (s.itemsize == 8 && e.itemsize == 8) {
+        bad = !lock_py_in_range(s.buf, count, ssign, max) || !lock_py_in_range(e.buf, count, esign, max);
+        if (!bad) {
+            unlocker_batch_u64(N, s.buf, e.buf, o.buf, count);
+        }
+    }
+    else {
+        //Narrower codes go through the 64-bit kernels a block at a time
+        uint64_t S[BATCH_BLOCK], E[BATCH_BLOCK];
+
+        for (k = 0; !bad && k < count; k += m) {
+            m = (count - k < BATCH_BLOCK) ? count - k : BATCH_BLOCK;
+            lock_py_widen(S, (const char *)s.buf + k * s.itemsize, s.itemsize, ssign, m);
+            lock_py_widen(E, (const char *)e.buf + k * e.itemsize, e.itemsize, esign, m);
+            bad = !lock_py_in_range(S, m, ssign, max) || !lock_py_in_range(E, m, esign, max);
+            if (!bad) {
+                unlocker_batch_u64(N, S, E, (int *)o.buf + k, m);
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&s);
+    PyBuffer_Release(&e);
+    PyBuffer_Release(&o);
+    if (bad) {
+        PyErr_Format(PyExc_ValueError, "codes must be 0..10^%d - 1", N);
+        Py_DECREF(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+// costs_text(N, S, E, out=None): S and E hold N-digit codes back to back as ASCII
+static PyObject *lock_py_costs_text(PyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *kwlist[] = { "N", "S", "E", "out", NULL };
+    PyObject *out = NULL, *res;
+    Py_buffer s, e, o;
+    Py_ssize_t N;
+    size_t count, k;
+    int bad;
+
+    (void)self;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ny*y*|O", kwlist, &N, &s, &e, &out)) {
+        return NULL;
+    }
+    if (N < 1 || s.len != e.len || s.len % N != 0) {
+        PyErr_SetString(PyExc_ValueError, "S and E must be the same length, a multiple of N >= 1");
+        PyBuffer_Release(&s);
+        PyBuffer_Release(&e);
+        return NULL;
+    }
+    count = (size_t)(s.len / N);
+    if ((res = lock_py_out(out, (Py_ssize_t)count, &o)) == NULL) {
+        PyBuffer_Release(&s);
+        PyBuffer_Release(&e);
+        return NULL;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    bad = lock_scan_digits(s.buf, (const char *)s.buf + s.len) != (const char *)s.buf + s.len ||
+          lock_scan_digits(e.buf, (const char *)e.buf + e.len) != (const char *)e.buf + e.len;
+    for (k = 0; !bad && k < count; k++) {
+        ((int *)o.buf)[k] = (int)lock_cost((size_t)N, (const char *)s.buf + k * N, (const char *)e.buf + k * N);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&s);
+    PyBuffer_Release(&e);
+    PyBuffer_Release(&o);
+    if (bad) {
+        PyErr_SetString(PyExc_ValueError, "codes must be ASCII digits");
+        Py_DECREF(res);
+        return NULL;
+    }
+
+    return res;
+}
+
+static PyMethodDef lock_py_methods[] = {
+    { "costs", (PyCFunction)(void (*)(void))lock_py_costs, METH_VARARGS | METH_KEYWORDS,
+      "costs(N, S, E, out=None)\n\nCost of every (S[k], E[k]) pair over the lowest N (<= 20) digits. S and E are\n"
+      "buffers of integers of any width; returns out, or a memoryview of C ints." },
+    { "costs_text", (PyCFunction)(void (*)(void))lock_py_costs_text, METH_VARARGS | METH_KEYWORDS,
+      "costs_text(N, S, E, out=None)\n\nLike costs(), but S and E are bytes-like objects of N-digit ASCII codes laid\n"
+      "end to end, so N is unlimited." },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef lock_py_module = {
+    PyModuleDef_HEAD_INIT, "combination_locks", "Lock costs from the C kernels.", -1, lock_py_methods,
+    NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_combination_locks(void) {
+    PyObject *m;
+
+    if (lock_backend_select(NULL) == NULL) {
+        PyErr_SetString(PyExc_RuntimeError, "LOCK_BACKEND names a backend this CPU doesn't support");
+        return NULL;
+    }
+    if ((m = PyModule_Create(&lock_py_module)) == NULL) {
+        return NULL;
+    }
+    PyModule_AddStringConstant(m, "backend", lock_backend->name);
+
+    return m;
+}
+#endif
+
+#ifndef LOCK_PYTHON_MODULE
+int main(int argc, char **argv) {
+    struct lock_opts opts = { 5, 0.02, 1000000, NULL, { 0, 0, 0 }, 1, LOCK_DIST_FIXED, NULL, 1000000, 16, 0, 0, 4, NULL, 10, 2, 0, 0, NULL };
+    const char *mode = "bench";
+    char **args = calloc(argc, sizeof(char *));
+    int j;
+
+    if (args == NULL) {
+        return 1;
+    }
+    opts.args = args;
+    if (argc > 1 && argv[1][0] != '-') {
+        mode = argv[1];
+        argv++;
+        argc--;
+    }
+
+    for (j = 1; j < argc; j++) {
+        if (argv[j][0] != '-') {
+            opts.args[opts.nargs++] = argv[j];
+        }
+        else if (strncmp(argv[j], "--threads=", 10) == 0) {
+            opts.pool.threads = atoi(argv[j] + 10);
+        }
+        else if (strncmp(argv[j], "--chunk=", 8) == 0) {
+            opts.pool.chunk = strtoull(argv[j] + 8, NULL, 10);
+        }
+        else if (strcmp(argv[j], "--pin") == 0) {
+            opts.pool.pin = 1;
+        }
+        else if (strncmp(argv[j], "--backend=", 10) == 0) {
+            opts.backend = argv[j] + 10;
+        }
+        else if (strncmp(argv[j], "--trials=", 9) == 0) {
+            opts.trials = atoi(argv[j] + 9);
+        }
+        else if (strncmp(argv[j], "--min-time=", 11) == 0) {
+            opts.min_time = atof(argv[j] + 11);
+        }
+        else if (strncmp(argv[j], "--max-digits=", 13) == 0) {
+            opts.max_digits = strtoull(argv[j] + 13, NULL, 10);
+        }
+        else if (strncmp(argv[j], "--seed=", 7) == 0) {
+            opts.seed = strtoull(argv[j] + 7, NULL, 10);
+        }
+        else if (strncmp(argv[j], "--dist=", 7) == 0) {
+            if ((opts.dist = lock_dist_parse(argv[j] + 7)) < 0) {
+                fprintf(stderr, "unknown distribution %s\n", argv[j] + 7);
+                return 1;
+            }
+        }
+        else if (strncmp(argv[j], "--cache=", 8) == 0) {
+            opts.cache = argv[j] + 8;
+        }
+        else if (strncmp(argv[j], "--count=", 8) == 0) {
+            opts.count = strtoull(argv[j] + 8, NULL, 10);
+        }
+        else if (strncmp(argv[j], "--width=", 8) == 0) {
+            opts.width = strtoull(argv[j] + 8, NULL, 10);
+        }
+        else if (strcmp(argv[j], "--bcd") == 0) {
+            opts.corpus_flags |= LOCK_CORPUS_BCD;
+        }
+        else if (strcmp(argv[j], "--variable") == 0) {
+            opts.corpus_flags |= LOCK_CORPUS_VARIABLE;
+        }
+        else if (strcmp(argv[j], "--stats") == 0) {
+            opts.stats = 1;
+        }
+        else if (strcmp(argv[j], "--list") == 0) {
+            opts.list = 1;
+        }
+        else if (strncmp(argv[j], "--depth=", 8) == 0) {
+            opts.depth = atoi(argv[j] + 8);
+        }
+        else if (strncmp(argv[j], "--engine=", 9) == 0) {
+            opts.engine = argv[j] + 9;
+        }
+        else if (strncmp(argv[j], "--k=", 4) == 0) {
+            opts.k = atoi(argv[j] + 4);
+        }
+        else if (strncmp(argv[j], "--budget=", 9) == 0) {
+            opts.budget = atoi(argv[j] + 9);
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", argv[j]);
+            return 1;
+        }
+    }
+    if (opts.trials < 1) {
+        opts.trials = 1;
+    }
+    if (opts.width < 1) {
+        opts.width = 1;
+    }
+
+    if (lock_backend_select(opts.backend) == NULL) {
+        fprintf(stderr, "backend %s is unknown or not supported on this CPU\n", opts.backend != NULL ? opts.backend : getenv("LOCK_BACKEND"));
+        return 1;
+    }
+    //Self-check the backends before timing them, not before every mode
+    if ((strcmp(mode, "bench") == 0 || strcmp(mode, "check") == 0) && lock_backend_check(LOCK_CHECK_SEED) != 0) {
+        return 1;
+    }
+
+    if (strcmp(mode, "bench") == 0) {
+        j = bench_suite(&opts);
+    }
+    else if (strcmp(mode, "check") == 0) {
+        j = check_main(&opts);
+    }
+    else if (strcmp(mode, "latency") == 0) {
+        j = latency_suite(&opts);
+    }
+    else if (strcmp(mode, "corpus-gen") == 0) {
+        j = corpus_gen_main(&opts);
+    }
+    else if (strcmp(mode, "corpus-score") == 0) {
+        j = corpus_score_main(&opts);
+    }
+    else if (strcmp(mode, "stream") == 0) {
+        j = stream_main(&opts);
+    }
+    else if (strcmp(mode, "pipeline") == 0) {
+        j = pipeline_main(&opts);
+    }
+    else if (strcmp(mode, "serve") == 0) {
+        j = serve_main(&opts);
+    }
+    else if (strcmp(mode, "loadgen") == 0) {
+        j = loadgen_main(&opts);
+    }
+    else if (strcmp(mode, "nearest") == 0) {
+        j = nearest_main(&opts);
+    }
+    else if (strcmp(mode, "ball") == 0) {
+        j = ball_main(&opts);
+    }
+    else if (strcmp(mode, "distribution") == 0) {
+        j = distribution_main(&opts);
+    }
+    else if (strcmp(mode, "shortest") == 0) {
+        j = shortest_main(&opts);
+    }
+    else {
+        fprintf(stderr, "unknown mode %s (bench, check, latency, corpus-gen, corpus-score, stream, pipeline, serve, loadgen, nearest, ball, distribution, shortest)\n", mode);
+        j = 1;
+    }
+
+    free(args);
+    return j;
+}
+#endif
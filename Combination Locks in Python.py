@@ -1,4 +1,5 @@
 from time import perf_counter
+from array import array
 import random
 
 def unlocker(N, S, E):
@@ -24,11 +25,19 @@ def unlocker(N, S, E):
                     
     return P
 
+# The C kernels as an extension module, built from the C file (see the comment at its end)
+try:
+    import combination_locks
+except ImportError:
+    combination_locks = None
+
 N = 0
 S = 0
 E = 0
+Ns = []
+Ss = []
+Es = []
 
-start = perf_counter()
 for i in range(100000):
     #For same lengths (Comment for different lengths and uncomment this section)
     N = 4
@@ -36,15 +45,31 @@ for i in range(100000):
     E = random.randint(1000, 9999)
 
     #For different lengths (Comment for same lengths and uncomment this section)
-    # N = random.randint(1, 100)
+    #Up to 19 digits, so every code fits the extension's 64-bit integers
+    # N = random.randint(1, 19)
     # S = random.randint(10 ** (N-1), (10**N) - 1)
     # E = random.randint(10 ** (N-1), (10**N) - 1)
 
-    unlocker(N, S, E)
+    Ns.append(N)
+    Ss.append(S)
+    Es.append(E)
 
+start = perf_counter()
+costs = [unlocker(N, S, E) for N, S, E in zip(Ns, Ss, Es)]
 t = (perf_counter() - start) * 1000
 print(P)
-print(t)
-# print(N)
-# print(S)
-# print(E)
\ No newline at end of file
+print("Python:", t, "ms")
+
+if combination_locks is None:
+    print("combination_locks isn't built, skipping the comparison")
+else:
+    #Shorter codes have zeros above their top digit on both sides, which cost nothing,
+    #so one call with the widest N covers every row
+    S_codes = array("Q", Ss)
+    E_codes = array("Q", Es)
+    start = perf_counter()
+    C_costs = combination_locks.costs(max(Ns), S_codes, E_codes)
+    t_C = (perf_counter() - start) * 1000
+    print("C (" + combination_locks.backend + "):", t_C, "ms")
+    print("Speedup:", t / t_C)
+    print("Same costs:", list(C_costs) == costs)